@@ -0,0 +1,344 @@
+#ifndef BITONIC_SIMD_H
+#define BITONIC_SIMD_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <immintrin.h>
+
+/* Branch free SIMD merge of two sorted uint32_t arrays with a bitonic merge network
+ * the loop keeps the W largest keys seen so far in a register, loads the next W keys
+ * from whichever input has the smaller head, and merges the two registers with
+ * min/max: the low half is written out, the high half is carried to the next step
+ * the same loop is stamped out by DEFINE_SIMD_MERGE for 4 (SSE4.1), 8 (AVX2) and
+ * 16 (AVX-512) lanes, merge_simd picks the widest the CPU supports at runtime
+ * (BITONIC_MERGE=scalar|sse|avx2|avx512 in the environment overrides the choice)
+ * under pthread_once, libsort.c holds the one choice of every library engine
+ */
+
+typedef void (*merge_fn)(const uint32_t *A, size_t m, const uint32_t *B, size_t n, uint32_t *C);
+
+// sequentially merge A (m) with B (n) into C
+static inline void merge_scalar(const uint32_t *A, size_t m, const uint32_t *B, size_t n, uint32_t *C) {
+    size_t i = 0, j = 0, k = 0;
+    while (i < m && j < n) {
+        if (A[i] <= B[j]) {
+            C[k++] = A[i++];
+        } else {
+            C[k++] = B[j++];
+        }
+    }
+    while (i < m) C[k++] = A[i++];
+    while (j < n) C[k++] = B[j++];
+}
+
+// 4 lanes: sort a bitonic register with compare exchanges at stride 2 and 1
+__attribute__((target("sse4.1")))
+static inline __m128i bitonic_sort_sse(__m128i v) {
+    __m128i p = _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+    v = _mm_blend_epi16(_mm_min_epu32(v, p), _mm_max_epu32(v, p), 0xF0);
+    p = _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1));
+    v = _mm_blend_epi16(_mm_min_epu32(v, p), _mm_max_epu32(v, p), 0xCC);
+    return v;
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128i reverse_sse(__m128i v) {
+    return _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+}
+
+// 8 lanes: strides 4 (swap 128 bit halves), 2 and 1
+__attribute__((target("avx2")))
+static inline __m256i bitonic_sort_avx2(__m256i v) {
+    __m256i p = _mm256_permute2x128_si256(v, v, 0x01);
+    v = _mm256_blend_epi32(_mm256_min_epu32(v, p), _mm256_max_epu32(v, p), 0xF0);
+    p = _mm256_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+    v = _mm256_blend_epi32(_mm256_min_epu32(v, p), _mm256_max_epu32(v, p), 0xCC);
+    p = _mm256_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1));
+    v = _mm256_blend_epi32(_mm256_min_epu32(v, p), _mm256_max_epu32(v, p), 0xAA);
+    return v;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i reverse_avx2(__m256i v) {
+    return _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+}
+
+// 16 lanes: strides 8 and 4 (swap 256 / 128 bit blocks), 2 and 1
+__attribute__((target("avx512f")))
+static inline __m512i bitonic_sort_avx512(__m512i v) {
+    __m512i p = _mm512_shuffle_i64x2(v, v, _MM_SHUFFLE(1, 0, 3, 2));
+    v = _mm512_mask_blend_epi32(0xFF00, _mm512_min_epu32(v, p), _mm512_max_epu32(v, p));
+    p = _mm512_shuffle_i64x2(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+    v = _mm512_mask_blend_epi32(0xF0F0, _mm512_min_epu32(v, p), _mm512_max_epu32(v, p));
+    p = _mm512_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+    v = _mm512_mask_blend_epi32(0xCCCC, _mm512_min_epu32(v, p), _mm512_max_epu32(v, p));
+    p = _mm512_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1));
+    v = _mm512_mask_blend_epi32(0xAAAA, _mm512_min_epu32(v, p), _mm512_max_epu32(v, p));
+    return v;
+}
+
+__attribute__((target("avx512f")))
+static inline __m512i reverse_avx512(__m512i v) {
+    return _mm512_permutexvar_epi32(_mm512_setr_epi32(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0), v);
+}
+
+/* NAME(A, m, B, n, C) merges A with B into C, W lanes of type VEC per register
+ * NAME##_network(&a, &b) merges two sorted registers: a gets the low half, b the high half
+ */
+#define DEFINE_SIMD_MERGE(NAME, TARGET, W, VEC, LOADU, STOREU, MIN, MAX, REVERSE, BITONIC_SORT)   \
+__attribute__((target(TARGET)))                                                                    \
+static inline void NAME##_network(VEC *a, VEC *b) {                                                \
+    VEC r = REVERSE(*b);                                                                           \
+    VEC lo = MIN(*a, r);                                                                           \
+    VEC hi = MAX(*a, r);                                                                           \
+    *a = BITONIC_SORT(lo);                                                                         \
+    *b = BITONIC_SORT(hi);                                                                         \
+}                                                                                                  \
+                                                                                                   \
+__attribute__((target(TARGET)))                                                                    \
+static inline void NAME(const uint32_t *A, size_t m, const uint32_t *B, size_t n, uint32_t *C) {   \
+    if (m < W || n < W) {                                                                          \
+        merge_scalar(A, m, B, n, C);                                                               \
+        return;                                                                                    \
+    }                                                                                              \
+    VEC out = LOADU(A);                                                                            \
+    VEC carry = LOADU(B);                                                                          \
+    size_t i = W, j = W;                                                                           \
+    NAME##_network(&out, &carry);                                                                  \
+    STOREU(C, out);                                                                                \
+    C += W;                                                                                        \
+                                                                                                   \
+    /* refill from the input with the smaller head, stop when it has no full register */          \
+    int take_a;                                                                                    \
+    for (;;) {                                                                                     \
+        take_a = i < m && (j >= n || A[i] <= B[j]);                                                \
+        if (take_a) {                                                                              \
+            if (i + W > m) break;                                                                  \
+            out = LOADU(A + i);                                                                    \
+            i += W;                                                                                \
+        } else {                                                                                   \
+            if (j + W > n) break;                                                                  \
+            out = LOADU(B + j);                                                                    \
+            j += W;                                                                                \
+        }                                                                                          \
+        NAME##_network(&out, &carry);                                                              \
+        STOREU(C, out);                                                                            \
+        C += W;                                                                                    \
+    }                                                                                              \
+                                                                                                   \
+    /* the carried keys and the short input fit a small buffer, then one scalar merge */          \
+    uint32_t rest[W];                                                                              \
+    uint32_t small[2 * W];                                                                         \
+    STOREU(rest, carry);                                                                           \
+    if (take_a) {                                                                                  \
+        merge_scalar(rest, W, A + i, m - i, small);                                                \
+        merge_scalar(small, W + m - i, B + j, n - j, C);                                           \
+    } else {                                                                                       \
+        merge_scalar(rest, W, B + j, n - j, small);                                                \
+        merge_scalar(small, W + n - j, A + i, m - i, C);                                           \
+    }                                                                                              \
+}
+
+#define LOADU_SSE(p) _mm_loadu_si128((const __m128i *)(p))
+#define STOREU_SSE(p, v) _mm_storeu_si128((__m128i *)(p), (v))
+#define LOADU_AVX2(p) _mm256_loadu_si256((const __m256i *)(p))
+#define STOREU_AVX2(p, v) _mm256_storeu_si256((__m256i *)(p), (v))
+#define LOADU_AVX512(p) _mm512_loadu_si512((const void *)(p))
+#define STOREU_AVX512(p, v) _mm512_storeu_si512((void *)(p), (v))
+
+DEFINE_SIMD_MERGE(merge_sse, "sse4.1", 4, __m128i, LOADU_SSE, STOREU_SSE,
+                  _mm_min_epu32, _mm_max_epu32, reverse_sse, bitonic_sort_sse)
+DEFINE_SIMD_MERGE(merge_avx2, "avx2", 8, __m256i, LOADU_AVX2, STOREU_AVX2,
+                  _mm256_min_epu32, _mm256_max_epu32, reverse_avx2, bitonic_sort_avx2)
+DEFINE_SIMD_MERGE(merge_avx512, "avx512f", 16, __m512i, LOADU_AVX512, STOREU_AVX512,
+                  _mm512_min_epu32, _mm512_max_epu32, reverse_avx512, bitonic_sort_avx512)
+
+// widest merge the CPU supports
+static inline merge_fn merge_select(void) {
+    const char *force = getenv("BITONIC_MERGE");
+    __builtin_cpu_init();
+
+    int has_sse = __builtin_cpu_supports("sse4.1");
+    int has_avx2 = __builtin_cpu_supports("avx2");
+    int has_avx512 = __builtin_cpu_supports("avx512f");
+
+    if (force) {
+        if (strcmp(force, "scalar") == 0) return merge_scalar;
+        if (strcmp(force, "sse") == 0 && has_sse) return merge_sse;
+        if (strcmp(force, "avx2") == 0 && has_avx2) return merge_avx2;
+        if (strcmp(force, "avx512") == 0 && has_avx512) return merge_avx512;
+    }
+    if (has_avx512) return merge_avx512;
+    if (has_avx2) return merge_avx2;
+    if (has_sse) return merge_sse;
+    return merge_scalar;
+}
+
+// merge picked by merge_select, set once by the first merge_simd
+#ifdef LIBSORT
+// defined once in libsort.c, so the engines of the library share one selection
+extern pthread_once_t merge_once;
+extern merge_fn merge_kernel;
+#else
+static pthread_once_t merge_once = PTHREAD_ONCE_INIT;
+static merge_fn merge_kernel = NULL;
+#endif
+
+static inline void merge_init(void) {
+    merge_kernel = merge_select();
+}
+
+// merge A (m) with B (n) into C, dispatched on first use
+static inline void merge_simd(const uint32_t *A, size_t m, const uint32_t *B, size_t n, uint32_t *C) {
+    pthread_once(&merge_once, merge_init);
+    merge_kernel(A, m, B, n, C);
+}
+
+/* Register resident sorting network for small tiles (AVX2)
+ * 64 keys are loaded as 8 registers of 8, an 8 input sorting network (19 min/max
+ * compare exchanges) sorts the columns, an 8x8 transpose turns the columns into 8
+ * sorted registers and bitonic merges of 1, 2 and 4 register runs finish the tile
+ */
+
+// compare exchange two registers lane by lane
+#define CMP_SWAP_AVX2(a, b) do {                 \
+    __m256i lo_ = _mm256_min_epu32((a), (b));    \
+    (b) = _mm256_max_epu32((a), (b));            \
+    (a) = lo_;                                   \
+} while (0)
+
+__attribute__((target("avx2")))
+static inline void transpose8_avx2(__m256i *r) {
+    __m256i t0 = _mm256_unpacklo_epi32(r[0], r[1]);
+    __m256i t1 = _mm256_unpackhi_epi32(r[0], r[1]);
+    __m256i t2 = _mm256_unpacklo_epi32(r[2], r[3]);
+    __m256i t3 = _mm256_unpackhi_epi32(r[2], r[3]);
+    __m256i t4 = _mm256_unpacklo_epi32(r[4], r[5]);
+    __m256i t5 = _mm256_unpackhi_epi32(r[4], r[5]);
+    __m256i t6 = _mm256_unpacklo_epi32(r[6], r[7]);
+    __m256i t7 = _mm256_unpackhi_epi32(r[6], r[7]);
+    __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+    __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+    __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+    __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+    __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+    __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+    __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+    __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+    r[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+    r[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+    r[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+    r[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+    r[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+    r[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+    r[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+    r[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+// merge the sorted runs v[0..n) and v[n..2n) of n registers each into one run
+__attribute__((target("avx2")))
+static inline void bitonic_merge_runs_avx2(__m256i *v, int n) {
+    // the second run reversed against the first: lows stay, highs move up
+    __m256i high[4];
+    for (int i = 0; i < n; i++) {
+        __m256i r = reverse_avx2(v[2 * n - 1 - i]);
+        high[i] = _mm256_max_epu32(v[i], r);
+        v[i] = _mm256_min_epu32(v[i], r);
+    }
+    for (int i = 0; i < n; i++) {
+        v[n + i] = high[i];
+    }
+
+    // both halves are bitonic now, clean across registers and then inside them
+    for (int half = 0; half < 2 * n; half += n) {
+        __m256i *w = v + half;
+        for (int stride = n / 2; stride > 0; stride /= 2) {
+            for (int i = 0; i < n; i++) {
+                if ((i & stride) == 0) {
+                    CMP_SWAP_AVX2(w[i], w[i + stride]);
+                }
+            }
+        }
+        for (int i = 0; i < n; i++) {
+            w[i] = bitonic_sort_avx2(w[i]);
+        }
+    }
+}
+
+// sort 64 keys (arr must hold 64)
+__attribute__((target("avx2")))
+static inline void sort64_avx2(uint32_t *arr) {
+    __m256i r[8];
+    for (int i = 0; i < 8; i++) {
+        r[i] = LOADU_AVX2(arr + 8 * i);
+    }
+
+    // sorting network on the 8 columns
+    CMP_SWAP_AVX2(r[0], r[2]); CMP_SWAP_AVX2(r[1], r[3]); CMP_SWAP_AVX2(r[4], r[6]); CMP_SWAP_AVX2(r[5], r[7]);
+    CMP_SWAP_AVX2(r[0], r[4]); CMP_SWAP_AVX2(r[1], r[5]); CMP_SWAP_AVX2(r[2], r[6]); CMP_SWAP_AVX2(r[3], r[7]);
+    CMP_SWAP_AVX2(r[0], r[1]); CMP_SWAP_AVX2(r[2], r[3]); CMP_SWAP_AVX2(r[4], r[5]); CMP_SWAP_AVX2(r[6], r[7]);
+    CMP_SWAP_AVX2(r[2], r[4]); CMP_SWAP_AVX2(r[3], r[5]);
+    CMP_SWAP_AVX2(r[1], r[4]); CMP_SWAP_AVX2(r[3], r[6]);
+    CMP_SWAP_AVX2(r[1], r[2]); CMP_SWAP_AVX2(r[3], r[4]); CMP_SWAP_AVX2(r[5], r[6]);
+
+    // every register becomes one sorted run of 8
+    transpose8_avx2(r);
+
+    // 8 -> 16 -> 32 -> 64
+    for (int n = 1; n < 8; n *= 2) {
+        for (int i = 0; i < 8; i += 2 * n) {
+            bitonic_merge_runs_avx2(r + i, n);
+        }
+    }
+
+    for (int i = 0; i < 8; i++) {
+        STOREU_AVX2(arr + 8 * i, r[i]);
+    }
+}
+
+// sort n keys in 64 key register tiles merged with merge_simd, tmp holds n keys
+// returns 0 without touching arr when the CPU has no AVX2
+static inline int sort_network(uint32_t *arr, size_t n, uint32_t *tmp) {
+    // the CPU model is filled in before main, the check is a load
+    if (!__builtin_cpu_supports("avx2")) {
+        return 0;
+    }
+
+    // full tiles in place, the last partial tile padded with the largest key
+    size_t full = n & ~(size_t)63;
+    for (size_t i = 0; i < full; i += 64) {
+        sort64_avx2(arr + i);
+    }
+    if (full < n) {
+        uint32_t pad[64];
+        size_t rest = n - full;
+        memcpy(pad, arr + full, rest * sizeof(uint32_t));
+        for (size_t i = rest; i < 64; i++) {
+            pad[i] = UINT32_MAX;
+        }
+        sort64_avx2(pad);
+        memcpy(arr + full, pad, rest * sizeof(uint32_t));
+    }
+
+    // bottom up merges of the sorted tiles
+    uint32_t *src = arr;
+    uint32_t *dst = tmp;
+    for (size_t width = 64; width < n; width *= 2) {
+        for (size_t lo = 0; lo < n; lo += 2 * width) {
+            size_t mid = lo + width < n ? lo + width : n;
+            size_t hi = lo + 2 * width < n ? lo + 2 * width : n;
+            merge_simd(src + lo, mid - lo, src + mid, hi - mid, dst + lo);
+        }
+        uint32_t *swap = src;
+        src = dst;
+        dst = swap;
+    }
+    if (src != arr) {
+        memcpy(arr, src, n * sizeof(uint32_t));
+    }
+    return 1;
+}
+
+#endif
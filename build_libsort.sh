@@ -0,0 +1,34 @@
+#!/bin/bash
+
+# Build libsort.a and libsort.so from the engine files (see libsort.h)
+# every engine is compiled with -DLIBSORT so its benchmark main is left out,
+# only the SIMD radix engine is built with -mavx2 (the dispatcher checks the CPU
+# before calling it), once as is and once with -DWC_SCATTER=1 (radix_simd_wc),
+# the other engines pick their SIMD kernels at runtime
+# the phase counter hooks are compiled in (-DSORT_PERF=1, perf_counters.h),
+# they cost a check per phase until perf_open
+set -e
+
+CFLAGS="-O3 -pthread -fPIC -DLIBSORT -DSORT_PERF=1"
+mkdir -p libsort_build
+
+gcc $CFLAGS -c libsort.c -o libsort_build/libsort.o
+gcc $CFLAGS -c radix_sorting_vanilla.c -o libsort_build/radix_sorting_vanilla.o
+gcc $CFLAGS -mavx2 -c radix_sorting_simd.c -o libsort_build/radix_sorting_simd.o
+gcc $CFLAGS -mavx2 -DWC_SCATTER=1 -c radix_sorting_simd.c -o libsort_build/radix_sorting_simd_wc.o
+gcc $CFLAGS -c radix_threads.c -o libsort_build/radix_threads.o
+gcc $CFLAGS -c radix_msd_inplace.c -o libsort_build/radix_msd_inplace.o
+gcc $CFLAGS -c radix_msd_parallel.c -o libsort_build/radix_msd_parallel.o
+gcc $CFLAGS -c merge_tile.c -o libsort_build/merge_tile.o
+gcc $CFLAGS -c merge_parallel.c -o libsort_build/merge_parallel.o
+gcc $CFLAGS -c merge_runs.c -o libsort_build/merge_runs.o
+gcc $CFLAGS -c counting_sort.c -o libsort_build/counting_sort.o
+gcc $CFLAGS -c radix_sorting_kv.c -o libsort_build/radix_sorting_kv.o
+gcc $CFLAGS -c radix_select.c -o libsort_build/radix_select.o
+gcc $CFLAGS -c external_sort.c -o libsort_build/external_sort.o
+gcc $CFLAGS -c sort_file.c -o libsort_build/sort_file.o
+gcc $CFLAGS -c perf_counters.c -o libsort_build/perf_counters.o
+
+rm -f libsort.a
+ar rcs libsort.a libsort_build/*.o
+gcc -shared -pthread -o libsort.so libsort_build/*.o
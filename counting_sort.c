@@ -0,0 +1,304 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <immintrin.h>
+#include "sort_timing.h"
+#include "sort_data.h"
+#include "libsort.h"
+
+/* Parallel counting sort for keys with a small range
+ * every thread counts the keys of its own chunk (4 interleaved sub-histograms
+ * for tiny ranges, so repeated keys don't wait on the same counter), the
+ * histograms are summed across threads per slice of values, and then every
+ * thread rewrites an equal slice of the output from the totals with broadcast
+ * vector stores, no key is ever moved on its own: one read plus one write,
+ * streaming (non-temporal) once the output is larger than the LLC
+ * the range is passed in by the caller (every key must lie in [min, max]) or
+ * found by counting_sort first
+ * COMPILE: gcc -O3 -pthread counting_sort.c -o counting_sort
+ *          gcc -O3 -pthread -DLIBSORT -c counting_sort.c (engine only, see libsort.h)
+ * RUN: ./counting_sort [power] [threads]
+ * with arguments only "power,size,cycles,ns,keys_per_s" is printed (data collection)
+ */
+
+#define MAX_THREADS 256
+#define COUNT_CHUNK (1 << 16)  // smallest chunk worth a thread
+#define SUB_RANGE 4096         // ranges up to this use 4 sub-histograms per thread
+#define SUB_BLOCK (1u << 30)   // keys counted into the 32 bit sub-histograms at a time
+
+typedef void (*fill_fn)(uint32_t *out, size_t count, uint32_t value, int stream);
+
+// state shared by every thread of one sort
+typedef struct {
+    uint32_t *arr;
+    size_t size;
+    uint32_t min;
+    size_t range;
+    int num_threads;
+    int stream;
+    fill_fn fill;     // vector fill picked by CPUID
+    size_t *counts;   // counts[thread * range + value]
+    size_t *totals;   // totals[value], summed over the threads
+    pthread_barrier_t barrier;
+} CountShared;
+
+typedef struct {
+    CountShared *shared;
+    int thread_id;
+} CountArgs;
+
+// size of the last level cache in bytes, used to decide on streaming stores
+static size_t llc_bytes() {
+    long llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    return llc > 0 ? (size_t)llc : (size_t)32 << 20;
+}
+
+static void fill_scalar(uint32_t *out, size_t count, uint32_t value, int stream) {
+    (void)stream;
+    for (size_t i = 0; i < count; i++) {
+        out[i] = value;
+    }
+}
+
+// count copies of value, 8 per store
+__attribute__((target("avx2")))
+static void fill_avx2(uint32_t *out, size_t count, uint32_t value, int stream) {
+    __m256i v = _mm256_set1_epi32((int)value);
+    size_t i = 0;
+
+    if (stream) {
+        // streaming stores need 32 byte alignment, the head is written one key at a time
+        while (i < count && ((uintptr_t)(out + i) & 31)) {
+            out[i++] = value;
+        }
+        for (; i + 8 <= count; i += 8) {
+            _mm256_stream_si256((__m256i *)(out + i), v);
+        }
+    } else {
+        for (; i + 8 <= count; i += 8) {
+            _mm256_storeu_si256((__m256i *)(out + i), v);
+        }
+    }
+    for (; i < count; i++) {
+        out[i] = value;
+    }
+}
+
+static fill_fn fill_select(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? fill_avx2 : fill_scalar;
+}
+
+// histogram of arr[lo..hi) into count (range entries, zeroed here)
+static void count_chunk(const uint32_t *arr, size_t lo, size_t hi, uint32_t min, size_t range, size_t *count) {
+    memset(count, 0, range * sizeof(size_t));
+
+    if (range > SUB_RANGE) {
+        for (size_t i = lo; i < hi; i++) {
+            count[arr[i] - min]++;
+        }
+        return;
+    }
+
+    // 4 sub-histograms, consecutive equal keys land on different counters
+    uint32_t subs[4][SUB_RANGE];
+    for (size_t start = lo; start < hi; start += SUB_BLOCK) {
+        size_t end = (hi - start > SUB_BLOCK) ? start + SUB_BLOCK : hi;
+        memset(subs, 0, sizeof(subs));
+
+        size_t i = start;
+        for (; i + 4 <= end; i += 4) {
+            subs[0][arr[i] - min]++;
+            subs[1][arr[i + 1] - min]++;
+            subs[2][arr[i + 2] - min]++;
+            subs[3][arr[i + 3] - min]++;
+        }
+        for (; i < end; i++) {
+            subs[0][arr[i] - min]++;
+        }
+
+        for (size_t v = 0; v < range; v++) {
+            count[v] += (size_t)subs[0][v] + subs[1][v] + subs[2][v] + subs[3][v];
+        }
+    }
+}
+
+// one thread: count its chunk, sum its slice of values, fill its slice of the output
+static void *count_thread(void *arg) {
+    CountArgs *args = (CountArgs *)arg;
+    CountShared *shared = args->shared;
+    int t = args->thread_id;
+    int num_threads = shared->num_threads;
+    size_t size = shared->size;
+    size_t range = shared->range;
+
+    size_t lo = size * t / num_threads;
+    size_t hi = size * (t + 1) / num_threads;
+    count_chunk(shared->arr, lo, hi, shared->min, range, shared->counts + (size_t)t * range);
+
+    // every histogram is complete, nothing reads the input after this barrier
+    pthread_barrier_wait(&shared->barrier);
+
+    size_t v_lo = range * t / num_threads;
+    size_t v_hi = range * (t + 1) / num_threads;
+    for (size_t v = v_lo; v < v_hi; v++) {
+        size_t total = 0;
+        for (int u = 0; u < num_threads; u++) {
+            total += shared->counts[(size_t)u * range + v];
+        }
+        shared->totals[v] = total;
+    }
+
+    pthread_barrier_wait(&shared->barrier);
+
+    // output slice [lo, hi) of this thread, value v covers [start, start + totals[v])
+    size_t start = 0;
+    for (size_t v = 0; v < range && start < hi; v++) {
+        size_t end = start + shared->totals[v];
+        size_t from = start > lo ? start : lo;
+        size_t to = end < hi ? end : hi;
+        if (from < to) {
+            shared->fill(shared->arr + from, to - from, shared->min + (uint32_t)v, shared->stream);
+        }
+        start = end;
+    }
+
+    // order the streaming stores before the caller reads the output
+    if (shared->stream) {
+        _mm_sfence();
+    }
+    return NULL;
+}
+
+// counting sort of keys known to lie in [min, max] on num_threads threads
+void counting_sort_range(uint32_t *arr, size_t size, uint32_t min, uint32_t max, int num_threads) {
+    if (size < 2) {
+        return;
+    }
+    if (num_threads < 1) {
+        num_threads = 1;
+    }
+    if (num_threads > MAX_THREADS) {
+        num_threads = MAX_THREADS;
+    }
+    if ((size_t)num_threads > size / COUNT_CHUNK) {
+        num_threads = size / COUNT_CHUNK > 0 ? (int)(size / COUNT_CHUNK) : 1;
+    }
+
+    CountShared shared;
+    shared.arr = arr;
+    shared.size = size;
+    shared.min = min;
+    shared.range = (size_t)(max - min) + 1;
+    shared.num_threads = num_threads;
+    // bypass the cache when the output can't stay in the LLC anyway
+    shared.stream = size * sizeof(uint32_t) > llc_bytes();
+    shared.fill = fill_select();
+    shared.counts = malloc((size_t)num_threads * shared.range * sizeof(size_t));
+    shared.totals = malloc(shared.range * sizeof(size_t));
+    if (!shared.counts || !shared.totals) {
+        perror("Failed to allocate memory for counts");
+        exit(EXIT_FAILURE);
+    }
+
+    if (pthread_barrier_init(&shared.barrier, NULL, num_threads) != 0) {
+        fprintf(stderr, "Failed to initialize barrier\n");
+        exit(EXIT_FAILURE);
+    }
+
+    pthread_t threads[MAX_THREADS];
+    CountArgs args[MAX_THREADS];
+
+    // the calling thread works as thread 0
+    for (int i = 1; i < num_threads; i++) {
+        args[i].shared = &shared;
+        args[i].thread_id = i;
+        if (pthread_create(&threads[i], NULL, count_thread, &args[i]) != 0) {
+            fprintf(stderr, "Failed to create thread %d\n", i);
+            exit(EXIT_FAILURE);
+        }
+    }
+    args[0].shared = &shared;
+    args[0].thread_id = 0;
+    count_thread(&args[0]);
+
+    for (int i = 1; i < num_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    pthread_barrier_destroy(&shared.barrier);
+    free(shared.totals);
+    free(shared.counts);
+}
+
+// counting sort, the key range is found first
+void counting_sort(uint32_t *arr, size_t size, int num_threads) {
+    if (size < 2) {
+        return;
+    }
+
+    uint32_t min = arr[0];
+    uint32_t max = arr[0];
+    for (size_t i = 1; i < size; i++) {
+        min = arr[i] < min ? arr[i] : min;
+        max = arr[i] > max ? arr[i] : max;
+    }
+    counting_sort_range(arr, size, min, max, num_threads);
+}
+
+#ifndef LIBSORT
+void sort_array(uint32_t *arr, size_t size) {
+    // use every online core
+    counting_sort(arr, size, (int)sysconf(_SC_NPROCESSORS_ONLN));
+}
+
+int main(int argc, char *argv[]) {
+    // FOR DATA COLLECTION pass the power of two of the array size (and a thread count)
+    int collect = (argc >= 2);
+    int power = collect ? atoi(argv[1]) : 26;
+    int num_threads = (argc > 2) ? atoi(argv[2]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    size_t size = (size_t)1 << power;
+
+    uint32_t *arr = malloc(size * sizeof(uint32_t));
+    if (!arr) {
+        perror("Failed to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+
+    // same keys as merge_parallel.c, 0..99
+    data_spec keys = data_spec_of(DATA_UNIFORM);
+    keys.range = 100;
+    data_fill_u32(arr, size, keys, (uint64_t)time(NULL), 0);
+    data_checksum checksum = data_checksum_u32(arr, size, 0);
+
+    // the range is known here, so the sort is one read and one write
+    uint64_t start, end, time;
+    start = rdtsc_start();
+    counting_sort_range(arr, size, 0, 99, num_threads);
+    end = rdtsc_stop();
+    time = end - start;
+
+    if (collect) {
+        printf("%d,%zu,%lu,%.0f,%.0f\n", power, size, time, timing_ns(time), timing_keys_per_s(time, size));
+    } else {
+        printf("Counting sort time (%d threads): " TIMING_FMT "\n", num_threads, TIMING_ARGS(time, size));
+    }
+
+    if (!data_verify_u32(arr, size, checksum, 0)) {
+        printf("Counting sort failed.\n");
+        free(arr);
+        return 1;
+    }
+
+    if (!collect) {
+        printf("done and validated\n");
+    }
+
+    free(arr);
+    return 0;
+}
+#endif
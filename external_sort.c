@@ -0,0 +1,564 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "sort_timing.h"
+#include "sort_data.h"
+#include "libsort.h"
+
+/* External sort of a binary uint32_t key file larger than memory
+ * run generation: the file is read in chunks of a quarter of the memory budget
+ * (three chunk buffers plus the scratch array of the radix sort), every chunk is
+ * sorted with the SIMD LSD radix (the parallel LSD radix with several threads)
+ * and written back as a run, while chunk i is sorted chunk i + 1 is read and run
+ * i - 1 is written on their own threads, so the disk and the sort overlap
+ * merge: the runs are merged through a loser tree (one comparison per tree
+ * level and key) into large sequential output blocks, a writer thread drains
+ * one output block while the next fills, the next block of every run is
+ * announced to the kernel with posix_fadvise so it is read ahead during the
+ * merge, when the budget can't hold a block of every run the runs are merged
+ * in several passes of at most MAX_FAN_IN runs
+ * every run sits at its input offset in a temporary file (<output>.runs), the
+ * passes ping-pong between it and the output, which is the last one written
+ * COMPILE: ./build_libsort.sh && gcc -O3 -pthread external_sort.c -L. -lsort -o external_sort
+ *          gcc -O3 -pthread -DLIBSORT -c external_sort.c (engine only, see libsort.h)
+ * RUN: ./external_sort <input> <output> [memory_mb] [threads]
+ *      ./external_sort (sorts 2^26 random keys with 32 MB, files in the current directory)
+ */
+
+#define MIN_BLOCK (1 << 16)  // fewest keys read from a run at a time (256 KB)
+#define MAX_FAN_IN 1024      // most runs merged in one pass
+
+// one sorted run of the current pass: keys [start, start + length) of its file
+typedef struct {
+    size_t start;
+    size_t length;
+} Run;
+
+// the next keys of one run being merged
+typedef struct {
+    int fd;
+    uint32_t *block;
+    size_t pos, count;    // block[pos..count) not merged yet
+    size_t next, end;     // file keys [next, end) not read yet
+} RunCursor;
+
+// one read or write of an I/O thread
+typedef struct {
+    int fd;
+    uint32_t *keys;
+    size_t count;
+    size_t offset;        // in keys
+    int write;
+    int failed;
+    int error;            // errno of the failed transfer
+    int threaded;         // 0 when it ran on the caller (no thread available)
+    pthread_t thread;
+} IoTask;
+
+// the whole of count keys at the key offset, short reads and writes are continued
+static int transfer(int fd, uint32_t *keys, size_t count, size_t offset, int write) {
+    char *data = (char *)keys;
+    size_t bytes = count * sizeof(uint32_t);
+    off_t position = (off_t)(offset * sizeof(uint32_t));
+
+    while (bytes > 0) {
+        ssize_t done = write ? pwrite(fd, data, bytes, position) : pread(fd, data, bytes, position);
+        if (done < 0 && errno == EINTR) {
+            continue;
+        }
+        if (done <= 0) {
+            if (done == 0) {
+                // the file ended before the keys did
+                errno = EIO;
+            }
+            return -1;
+        }
+        data += done;
+        bytes -= (size_t)done;
+        position += done;
+    }
+    return 0;
+}
+
+static void *io_thread(void *arg) {
+    IoTask *task = (IoTask *)arg;
+    task->failed = transfer(task->fd, task->keys, task->count, task->offset, task->write) != 0;
+    task->error = task->failed ? errno : 0;
+    return NULL;
+}
+
+static void io_start(IoTask *task, int fd, uint32_t *keys, size_t count, size_t offset, int write) {
+    task->fd = fd;
+    task->keys = keys;
+    task->count = count;
+    task->offset = offset;
+    task->write = write;
+    task->failed = 0;
+    task->threaded = pthread_create(&task->thread, NULL, io_thread, task) == 0;
+    if (!task->threaded) {
+        // no overlap, but the transfer still happens
+        io_thread(task);
+    }
+}
+
+// 0 when the transfer went through, -1 with its errno otherwise
+static int io_wait(IoTask *task) {
+    if (task->threaded) {
+        pthread_join(task->thread, NULL);
+    }
+    if (task->failed) {
+        errno = task->error;
+        return -1;
+    }
+    return 0;
+}
+
+// sort every chunk of the input into a run of out, chunk keys per run
+static int generate_runs(int in, int out, size_t total, size_t chunk, int num_threads) {
+    libsort_engine engine = num_threads > 1 ? LIBSORT_RADIX_PARALLEL : LIBSORT_RADIX_SIMD;
+    size_t chunks = (total + chunk - 1) / chunk;
+    uint32_t *buffers[3];
+    IoTask reads[3], writes[3];
+    int failed = 0;
+
+    if (chunks == 0) {
+        return 0;
+    }
+    for (int b = 0; b < 3; b++) {
+        buffers[b] = malloc(chunk * sizeof(uint32_t));
+        if (!buffers[b]) {
+            while (b-- > 0) {
+                free(buffers[b]);
+            }
+            errno = ENOMEM;
+            return -1;
+        }
+    }
+
+    // chunk i lives in buffers[i % 3]: read in step i - 1, sorted in step i,
+    // written until the read of step i + 2 needs the buffer again
+    io_start(&reads[0], in, buffers[0], chunk < total ? chunk : total, 0, 0);
+    for (size_t i = 0; i < chunks; i++) {
+        size_t start = i * chunk;
+        size_t count = (total - start < chunk) ? total - start : chunk;
+
+        if (i >= 2) {
+            failed |= io_wait(&writes[(i - 2) % 3]);
+        }
+        if (i + 1 < chunks) {
+            size_t next = start + chunk;
+            size_t next_count = (total - next < chunk) ? total - next : chunk;
+            io_start(&reads[(i + 1) % 3], in, buffers[(i + 1) % 3], next_count, next, 0);
+        }
+
+        failed |= io_wait(&reads[i % 3]);
+        libsort_sort_with(engine, buffers[i % 3], count, num_threads);
+        io_start(&writes[i % 3], out, buffers[i % 3], count, start, 1);
+    }
+    for (size_t i = chunks > 2 ? chunks - 2 : 0; i < chunks; i++) {
+        failed |= io_wait(&writes[i % 3]);
+    }
+
+    int saved = errno;
+    for (int b = 0; b < 3; b++) {
+        free(buffers[b]);
+    }
+    errno = saved;
+    return failed ? -1 : 0;
+}
+
+// refill an empty cursor with the next block of its run, 0 or -1 when the read failed
+static int cursor_fill(RunCursor *cursor, size_t block) {
+    size_t count = cursor->end - cursor->next < block ? cursor->end - cursor->next : block;
+    if (count > 0 && transfer(cursor->fd, cursor->block, count, cursor->next, 0) != 0) {
+        cursor->pos = cursor->count = 0;
+        return -1;
+    }
+    cursor->next += count;
+    cursor->pos = 0;
+    cursor->count = count;
+
+    // start reading the block after this one while this one is merged
+    if (cursor->next < cursor->end) {
+        size_t ahead = cursor->end - cursor->next < block ? cursor->end - cursor->next : block;
+        posix_fadvise(cursor->fd, (off_t)(cursor->next * sizeof(uint32_t)),
+                      (off_t)(ahead * sizeof(uint32_t)), POSIX_FADV_WILLNEED);
+    }
+    return 0;
+}
+
+// head key of a cursor, runs that are used up compare above every key
+static inline uint64_t cursor_head(const RunCursor *cursor) {
+    return cursor->pos < cursor->count ? cursor->block[cursor->pos] : UINT64_MAX;
+}
+
+// merge runs[0..k) of in into one run of out at runs[0].start
+// block keys per input and output buffer, 0 or -1 with errno set
+static int merge_runs_to(int in, int out, const Run *runs, int k, size_t block) {
+    RunCursor *cursors = calloc(k, sizeof(RunCursor));
+    uint64_t *heads = malloc(k * sizeof(uint64_t));
+    int *tree = malloc(k * sizeof(int)); // tree[0] the winner, tree[1..k) the loser of each match
+    uint32_t *output[2];
+    output[0] = malloc(block * sizeof(uint32_t));
+    output[1] = malloc(block * sizeof(uint32_t));
+    int failed = !cursors || !heads || !tree || !output[0] || !output[1];
+    if (failed) {
+        errno = ENOMEM;
+        goto done;
+    }
+
+    size_t total = 0;
+    for (int r = 0; r < k; r++) {
+        cursors[r].fd = in;
+        cursors[r].block = malloc(block * sizeof(uint32_t));
+        if (!cursors[r].block) {
+            errno = ENOMEM;
+            failed = 1;
+            goto done;
+        }
+        cursors[r].next = runs[r].start;
+        cursors[r].end = runs[r].start + runs[r].length;
+        if (cursor_fill(&cursors[r], block) != 0) {
+            failed = 1;
+            goto done;
+        }
+        heads[r] = cursor_head(&cursors[r]);
+        total += runs[r].length;
+        tree[r] = -1;
+    }
+
+    // leaf r sits at node k + r, node n plays the winners of 2n and 2n + 1,
+    // the first leaf to reach a node waits there, the second plays it
+    for (int r = 0; r < k; r++) {
+        int winner = r;
+        int node = (r + k) / 2;
+        while (node > 0) {
+            if (tree[node] < 0) {
+                tree[node] = winner;
+                break;
+            }
+            if (heads[tree[node]] < heads[winner]) {
+                int swap = tree[node];
+                tree[node] = winner;
+                winner = swap;
+            }
+            node /= 2;
+        }
+        if (node == 0) {
+            tree[0] = winner;
+        }
+    }
+
+    IoTask write;
+    int writing = 0;
+    int current = 0;
+    size_t filled = 0;
+    size_t written = runs[0].start;
+
+    for (size_t i = 0; i < total && !failed; i++) {
+        int winner = tree[0];
+        output[current][filled++] = (uint32_t)heads[winner];
+
+        // next key of the winning run, then replay its path to the root
+        RunCursor *cursor = &cursors[winner];
+        if (++cursor->pos == cursor->count && cursor_fill(cursor, block) != 0) {
+            failed = 1;
+            break;
+        }
+        heads[winner] = cursor_head(cursor);
+        uint64_t key = heads[winner];
+        for (int node = (winner + k) / 2; node > 0; node /= 2) {
+            if (heads[tree[node]] < key) {
+                int swap = tree[node];
+                tree[node] = winner;
+                winner = swap;
+                key = heads[winner];
+            }
+        }
+        tree[0] = winner;
+
+        // hand the full block to the writer and fill the other one meanwhile
+        if (filled == block || i + 1 == total) {
+            if (writing && io_wait(&write) != 0) {
+                writing = 0;
+                failed = 1;
+                break;
+            }
+            io_start(&write, out, output[current], filled, written, 1);
+            writing = 1;
+            written += filled;
+            filled = 0;
+            current ^= 1;
+        }
+    }
+    if (writing && io_wait(&write) != 0) {
+        failed = 1;
+    }
+
+done: {
+        int saved = errno;
+        for (int r = 0; cursors && r < k; r++) {
+            free(cursors[r].block);
+        }
+        free(output[1]);
+        free(output[0]);
+        free(tree);
+        free(heads);
+        free(cursors);
+        errno = saved;
+        return failed ? -1 : 0;
+    }
+}
+
+static int copy_run(int in, int out, const Run *run, size_t block) {
+    uint32_t *keys = malloc(block * sizeof(uint32_t));
+    if (!keys) {
+        errno = ENOMEM;
+        return -1;
+    }
+    int failed = 0;
+    for (size_t done = 0; done < run->length && !failed; done += block) {
+        size_t count = run->length - done < block ? run->length - done : block;
+        failed = transfer(in, keys, count, run->start + done, 0) != 0 ||
+                 transfer(out, keys, count, run->start + done, 1) != 0;
+    }
+    int saved = errno;
+    free(keys);
+    errno = saved;
+    return failed ? -1 : 0;
+}
+
+// sorts the uint32_t keys of the file input into the file output with about
+// memory bytes of buffers, returns 0, or -1 after an I/O error (errno is set),
+// EINVAL when output is the input file or the size isn't a multiple of 4 bytes
+int external_sort_file(const char *input, const char *output, size_t memory, int num_threads) {
+    if (num_threads < 1) {
+        num_threads = 1;
+    }
+    int in = open(input, O_RDONLY);
+    if (in < 0) {
+        return -1;
+    }
+    struct stat info, out_info;
+    if (fstat(in, &info) != 0) {
+        close(in);
+        return -1;
+    }
+    // the output is truncated and the runs written to it while the input is
+    // still read, so both can't be the same file (a path or a link to it)
+    if (stat(output, &out_info) == 0 && out_info.st_dev == info.st_dev && out_info.st_ino == info.st_ino) {
+        close(in);
+        errno = EINVAL;
+        return -1;
+    }
+    // a file that isn't whole keys isn't a key file (sort_file says the same)
+    if ((size_t)info.st_size % sizeof(uint32_t) != 0) {
+        close(in);
+        errno = EINVAL;
+        return -1;
+    }
+    size_t total = (size_t)info.st_size / sizeof(uint32_t);
+    posix_fadvise(in, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    // the runs and every pass but the last go to the temporary file
+    size_t name_size = strlen(output) + sizeof(".runs");
+    char *runs_name = malloc(name_size);
+    if (!runs_name) {
+        close(in);
+        errno = ENOMEM;
+        return -1;
+    }
+    snprintf(runs_name, name_size, "%s.runs", output);
+
+    int out = open(output, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    int tmp = open(runs_name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (out < 0 || tmp < 0) {
+        int saved = errno;
+        close(in);
+        if (out >= 0) close(out);
+        if (tmp >= 0) close(tmp);
+        unlink(runs_name);
+        free(runs_name);
+        errno = saved;
+        return -1;
+    }
+
+    size_t chunk = memory / 4 / sizeof(uint32_t);
+    chunk = chunk < MIN_BLOCK ? MIN_BLOCK : chunk;
+    size_t num_runs = total > 0 ? (total + chunk - 1) / chunk : 0;
+
+    // fan in so a block of every run and two output blocks fit the budget
+    size_t fan_in = memory / sizeof(uint32_t) / MIN_BLOCK;
+    fan_in = fan_in > 2 ? fan_in - 2 : 2;
+    fan_in = fan_in < MAX_FAN_IN ? fan_in : MAX_FAN_IN;
+    fan_in = fan_in < num_runs ? fan_in : (num_runs > 2 ? num_runs : 2);
+    size_t block = memory / sizeof(uint32_t) / (fan_in + 2);
+    block = block < MIN_BLOCK ? MIN_BLOCK : block;
+
+    // merge passes, the runs start in the file that makes the last pass end in output
+    int passes = 0;
+    for (size_t runs = num_runs; runs > 1; runs = (runs + fan_in - 1) / fan_in) {
+        passes++;
+    }
+    int files[2] = {out, tmp};
+    int src = passes & 1;
+
+    int failed = generate_runs(in, files[src], total, chunk, num_threads);
+
+    Run *runs = failed ? NULL : malloc((num_runs + 1) * sizeof(Run));
+    if (!failed && !runs) {
+        errno = ENOMEM;
+        failed = 1;
+    }
+    for (size_t r = 0; !failed && r < num_runs; r++) {
+        runs[r].start = r * chunk;
+        runs[r].length = (total - r * chunk < chunk) ? total - r * chunk : chunk;
+    }
+
+    while (!failed && num_runs > 1) {
+        size_t merged = 0;
+        for (size_t r = 0; r < num_runs && !failed; r += fan_in) {
+            int k = (int)(num_runs - r < fan_in ? num_runs - r : fan_in);
+            if (k == 1) {
+                // a last run without partners moves to the other file as it is
+                failed |= copy_run(files[src], files[src ^ 1], &runs[r], block);
+            } else {
+                failed |= merge_runs_to(files[src], files[src ^ 1], &runs[r], k, block);
+            }
+            Run group = {runs[r].start, 0};
+            for (int g = 0; g < k; g++) {
+                group.length += runs[r + g].length;
+            }
+            runs[merged++] = group;
+        }
+        num_runs = merged;
+        src ^= 1;
+    }
+
+    int saved = errno;
+    free(runs);
+    close(in);
+    close(tmp);
+    unlink(runs_name);
+    free(runs_name);
+    if (close(out) != 0 && !failed) {
+        failed = 1;
+        saved = errno;
+    }
+    if (failed) {
+        // no half written output is left behind
+        unlink(output);
+    }
+    errno = saved;
+    return failed ? -1 : 0;
+}
+
+#ifndef LIBSORT
+// writes size random keys to path, returns their checksum
+static data_checksum write_random_file(const char *path, size_t size) {
+    FILE *file = fopen(path, "wb");
+    size_t block_keys = (size_t)1 << 22;
+    uint32_t *block = malloc(block_keys * sizeof(uint32_t));
+    if (!file || !block) {
+        perror("Failed to create input file");
+        exit(EXIT_FAILURE);
+    }
+    data_checksum checksum = { { 0, 0 } };
+    uint64_t seed = (uint64_t)time(NULL);
+    for (size_t done = 0; done < size; done += block_keys) {
+        size_t count = size - done < block_keys ? size - done : block_keys;
+        // a stream of its own per block
+        data_fill_u32(block, count, data_spec_of(DATA_UNIFORM), seed + done, 0);
+        checksum = data_checksum_add(checksum, data_checksum_u32(block, count, 0));
+        if (fwrite(block, sizeof(uint32_t), count, file) != count) {
+            perror("Failed to write input file");
+            exit(EXIT_FAILURE);
+        }
+    }
+    free(block);
+    fclose(file);
+    return checksum;
+}
+
+// 1 when the keys of path are in order and there are size of them, with the
+// checksum of the input unless check is 0
+static int file_sorted(const char *path, size_t size, data_checksum input, int check) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return 0;
+    }
+    uint32_t block[4096];
+    uint32_t last = 0;
+    size_t seen = 0;
+    size_t count;
+    data_checksum checksum = { { 0, 0 } };
+    while ((count = fread(block, sizeof(uint32_t), 4096, file)) > 0) {
+        // order and checksum in one read of the block
+        data_scan scan = data_scan_keys(block, 32, count, 1);
+        if (block[0] < last || !scan.sorted) {
+            fclose(file);
+            return 0;
+        }
+        checksum = data_checksum_add(checksum, scan.checksum);
+        last = block[count - 1];
+        seen += count;
+    }
+    fclose(file);
+    return seen == size && (!check || data_checksum_equal(checksum, input));
+}
+
+int main(int argc, char *argv[]) {
+    // a key file and where its sorted keys go, or nothing for a self test
+    int test = (argc < 3);
+    const char *input = test ? "external_input.bin" : argv[1];
+    const char *output = test ? "external_output.bin" : argv[2];
+    size_t memory_mb = (argc > 3) ? (size_t)atol(argv[3]) : (test ? 32 : 1024);
+    int num_threads = (argc > 4) ? atoi(argv[4]) : 1;
+
+    size_t size = (size_t)1 << 26;
+    data_checksum checksum = { { 0, 0 } };
+    if (test) {
+        checksum = write_random_file(input, size);
+    } else {
+        struct stat info;
+        if (stat(input, &info) != 0) {
+            perror("Failed to open input file");
+            return 1;
+        }
+        size = (size_t)info.st_size / sizeof(uint32_t);
+    }
+
+    uint64_t start, end, time;
+    start = rdtsc_start();
+    int failed = external_sort_file(input, output, memory_mb << 20, num_threads);
+    end = rdtsc_stop();
+    time = end - start;
+
+    if (failed) {
+        perror("External sort failed");
+        return 1;
+    }
+    printf("External sort time (%zu keys, %zu MB): " TIMING_FMT "\n", size, memory_mb, TIMING_ARGS(time, size));
+
+    // a key file given on the command line is only checked for order
+    if (!file_sorted(output, size, checksum, test)) {
+        printf("External sorting failed.\n");
+        return 1;
+    }
+    printf("done and validated\n");
+
+    if (test) {
+        unlink(input);
+        unlink(output);
+    }
+    return 0;
+}
+#endif
@@ -0,0 +1,125 @@
+#ifndef INPUT_PROFILE_H
+#define INPUT_PROFILE_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Cheap look at an input before choosing a sort (see libsort.c)
+ * one read of the keys finds the key range, the number of descents
+ * (arr[i] > arr[i + 1], 0 means sorted), of ascents (0 means non-increasing) and
+ * of turns (a key strictly above or below both neighbours), every boundary of
+ * ascending or descending runs is about two turns, so runs ~ turns / 2 + 1
+ * the loop has no branches so it vectorizes
+ * the distinct value density is estimated from PROFILE_SAMPLE evenly spaced keys
+ * ranges can be profiled on separate threads and combined with profile_combine
+ */
+
+#define PROFILE_SAMPLE 1024  // keys sampled for the distinct value estimate
+#define PROFILE_BLOCK (1 << 16) // keys counted in 32 bit lanes before adding to the totals
+
+typedef struct {
+    size_t size;
+    uint32_t min, max;
+    size_t descents;        // arr[i] > arr[i + 1]
+    size_t ascents;         // arr[i] < arr[i + 1]
+    size_t turns;           // arr[i] is a strict peak or valley
+    size_t sample_size;     // keys in the distinct value sample
+    size_t sample_distinct; // distinct keys among them
+} input_profile;
+
+// 1 if arr[i] is a strict peak or valley, 0 < i < size - 1
+static inline int profile_turn(const uint32_t *arr, size_t i) {
+    return ((arr[i - 1] < arr[i]) & (arr[i] > arr[i + 1])) |
+           ((arr[i - 1] > arr[i]) & (arr[i] < arr[i + 1]));
+}
+
+// key range and order of arr[0..size), size > 0
+static inline void profile_range(const uint32_t *arr, size_t size, input_profile *p) {
+    uint32_t min = arr[0];
+    uint32_t max = arr[0];
+    size_t descents = 0;
+    size_t ascents = 0;
+    size_t turns = 0;
+
+    for (size_t start = 1; start < size; start += PROFILE_BLOCK) {
+        size_t end = (size - start > PROFILE_BLOCK) ? start + PROFILE_BLOCK : size;
+        uint32_t down = 0;
+        uint32_t up = 0;
+        uint32_t turn = 0;
+        for (size_t i = start; i < end; i++) {
+            uint32_t prev = arr[i - 1];
+            uint32_t value = arr[i];
+            min = value < min ? value : min;
+            max = value > max ? value : max;
+            down += prev > value;
+            up += prev < value;
+        }
+        // the last key has no right neighbour
+        size_t turn_end = end < size ? end : size - 1;
+        for (size_t i = start; i < turn_end; i++) {
+            turn += profile_turn(arr, i);
+        }
+        descents += down;
+        ascents += up;
+        turns += turn;
+    }
+
+    p->size = size;
+    p->min = min;
+    p->max = max;
+    p->descents = descents;
+    p->ascents = ascents;
+    p->turns = turns;
+    p->sample_size = 0;
+    p->sample_distinct = 0;
+}
+
+// fold the profile of the range right after p's range into p, boundary is its first index in arr
+static inline void profile_combine(input_profile *p, const input_profile *next, const uint32_t *arr, size_t boundary) {
+    p->size += next->size;
+    p->min = next->min < p->min ? next->min : p->min;
+    p->max = next->max > p->max ? next->max : p->max;
+    p->descents += next->descents + (arr[boundary - 1] > arr[boundary]);
+    p->ascents += next->ascents + (arr[boundary - 1] < arr[boundary]);
+    // the keys on both sides of the boundary had a missing neighbour in their range
+    if (next->size > 1) {
+        p->turns += profile_turn(arr, boundary);
+    }
+    if (boundary >= 2) {
+        p->turns += profile_turn(arr, boundary - 1);
+    }
+    p->turns += next->turns;
+}
+
+static inline int profile_compare(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+// estimate the distinct value density from evenly spaced keys
+static inline void profile_sample(const uint32_t *arr, size_t size, input_profile *p) {
+    uint32_t sample[PROFILE_SAMPLE];
+    size_t count = size < PROFILE_SAMPLE ? size : PROFILE_SAMPLE;
+
+    for (size_t i = 0; i < count; i++) {
+        sample[i] = arr[i * size / count];
+    }
+    qsort(sample, count, sizeof(uint32_t), profile_compare);
+
+    size_t distinct = count > 0;
+    for (size_t i = 1; i < count; i++) {
+        distinct += sample[i] != sample[i - 1];
+    }
+    p->sample_size = count;
+    p->sample_distinct = distinct;
+}
+
+// full profile on the calling thread
+static inline void profile_input(const uint32_t *arr, size_t size, input_profile *p) {
+    profile_range(arr, size, p);
+    profile_sample(arr, size, p);
+}
+
+#endif
@@ -2,30 +2,26 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <time.h>
+#include "sort_timing.h"
+#include "sort_data.h"
 
 
-/* COMPILE: gcc iterative_merge.c -o iterative_merge
+/* COMPILE: gcc -pthread iterative_merge.c -o iterative_merge
  * RUN: ./iterative_merge
  */
 
-static inline uint64_t rdtsc() {
-    unsigned long a, d;
-    asm volatile("rdtsc" : "=a"(a), "=d"(d));
-    return a | ((uint64_t)d << 32);
-}
-
 // Utility function to find the minimum of two integers
 int min(int x, int y) { return (x < y) ? x : y; }
 
 /* Function to merge the two halves arr[l..m] and arr[m+1..h] of array arr[] */
-void merge(int arr[], int l, int m, int h) {
+void merge(uint32_t arr[], int l, int m, int h) {
     int i, j, k;
     int n1 = m - l + 1;
     int n2 = h - m;
 
     // Dynamically allocate memory for temporary arrays L[] and R[]
-    int *L = (int *)malloc(n1 * sizeof(int));
-    int *R = (int *)malloc(n2 * sizeof(int));
+    uint32_t *L = (uint32_t *)malloc(n1 * sizeof(uint32_t));
+    uint32_t *R = (uint32_t *)malloc(n2 * sizeof(uint32_t));
 
     if (L == NULL || R == NULL) {
         perror("Failed to allocate memory for temporary arrays");
@@ -73,7 +69,7 @@ void merge(int arr[], int l, int m, int h) {
 }
 
 /* Iterative merge sort function to sort arr[l...h] */
-void mergeSort(int arr[], int l, int h) {
+void mergeSort(uint32_t arr[], int l, int h) {
     int curr_size; // For current size of subarrays to be merged
     int left_start; // For picking starting index of left subarray to be merged
 
@@ -112,27 +108,24 @@ int main() {
         perror("Failed to allocate memory");
         exit(EXIT_FAILURE);
     }
-    srand((unsigned)time(NULL)); // Seed the random number generator
-    for (size_t i = 0; i < size; i++)
-        sorted_arr[i] = rand();
+    data_fill_u32(sorted_arr, size, data_spec_of(DATA_UNIFORM), (uint64_t)time(NULL), 0);
+    data_checksum checksum = data_checksum_u32(sorted_arr, size, 0);
 
     // Declare variables for timing
     uint64_t start, end, time;
 
-    start = rdtsc();
+    start = rdtsc_start();
     // Sort the array
     sort_array(sorted_arr, size);
-    end = rdtsc();
+    end = rdtsc_stop();
     time = end - start;
 
-    printf("Sort time: %llu cycles\n", time);
+    printf("Sort time: " TIMING_FMT "\n", TIMING_ARGS(time, size));
 
-    for (size_t i = 1; i < size; i++) {
-        if (sorted_arr[i - 1] > sorted_arr[i] ) {
-            printf("Simd sorting failed.\n");
-            free(sorted_arr);
-            return 1;
-        }
+    if (!data_verify_u32(sorted_arr, size, checksum, 0)) {
+        printf("Simd sorting failed.\n");
+        free(sorted_arr);
+        return 1;
     }
 
     // Uncomment this to print the sorted array if needed
@@ -0,0 +1,331 @@
+#ifndef LIBSORT
+#define LIBSORT
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "thread_pool.h"
+#include "radix_histogram.h"
+#include "bitonic_simd.h"
+#include "libsort.h"
+
+/* Dispatcher of libsort, sort_array first profiles the input in one read
+ * (input_profile.h, split across the pool for large inputs):
+ *   no descents                already sorted, nothing to do
+ *   no ascents                 non-increasing, reversed in place
+ *   key range <= COUNTING_RANGE and <= size
+ *                              counting sort on the measured range
+ *   at most MAX_MERGE_RUNS runs (estimated from the turns)
+ *                              natural merge sort of the runs
+ *   up to SMALL_SORT keys      tiled merge sort, too few keys to pay for 256 bucket passes
+ *   at most FEW_DISTINCT distinct keys in the sample
+ *                              in-place MSD radix, the buckets hold equal keys after
+ *                              one level (4M keys, 16 distinct: 20 vs 29 cycles/key)
+ * everything else goes by the input size, the CPU features and the thread budget:
+ *   one thread or < PARALLEL_SORT keys
+ *                              AVX2 LSD radix, in-place MSD radix without AVX2
+ *   larger, several threads    LSD radix with every pass split across the threads
+ * both LSD radix engines skip the passes of bytes every key shares, so small
+ * keys above the counting range get fewer passes without a separate engine
+ * AVX-512 kernels are picked inside the engines (histogram_select, merge_select),
+ * on the test machine they moved neither crossover so only AVX2 changes the choice
+ * single thread crossovers (cycles/key, rand() keys): 128 keys merge 14 / radix 20,
+ * 512 keys merge 17 / radix 12
+ * COMPILE: ./build_libsort.sh
+ */
+
+#define SMALL_SORT 256          // largest input for the tiled merge sort
+#define PARALLEL_SORT (1 << 18) // smallest input worth starting threads for
+#define COUNTING_RANGE (1 << 16) // widest key range for the counting sort (counts stay in L2)
+#define MAX_MERGE_RUNS 1024      // most runs worth merging (at most 10 merge passes)
+#define FEW_DISTINCT 32          // distinct keys in the profile sample for the MSD radix
+#define PROFILE_CHUNK (1 << 18)  // smallest range profiled by one task
+#define MAX_PROFILE_CHUNKS 64
+
+// worker slot of the pool threads, shared by every engine (see thread_pool.h)
+__thread thread_pool *pool_current = NULL;
+__thread int pool_slot = 0;
+
+// histogram kernel of every radix engine, picked once (see radix_histogram.h)
+pthread_once_t histogram_once = PTHREAD_ONCE_INIT;
+histogram_fn histogram_kernel = NULL;
+pthread_once_t histogram_all_once = PTHREAD_ONCE_INIT;
+histogram_all_fn histogram_all_kernel = NULL;
+const char *histogram_all_kernel_name = NULL;
+
+// merge kernel of every merge engine, picked once (see bitonic_simd.h)
+pthread_once_t merge_once = PTHREAD_ONCE_INIT;
+merge_fn merge_kernel = NULL;
+
+// process wide pool of the pool engines, one worker per core besides the caller
+static thread_pool *library_pool;
+static pthread_once_t library_pool_once = PTHREAD_ONCE_INIT;
+
+// pools of the smaller thread budgets (index = budget), started on the first
+// sort with that budget and kept like the library pool, so no sort pays for
+// starting and joining its threads
+static thread_pool **budget_pools;
+static pthread_mutex_t budget_pools_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int online_cores(void) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (int)cores : 1;
+}
+
+static void library_pool_init(void) {
+    library_pool = pool_create(online_cores() - 1);
+    budget_pools = calloc(online_cores(), sizeof(thread_pool *));
+    if (!budget_pools) {
+        perror("Failed to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// the pool of a thread budget, the library pool from one thread per core up
+static thread_pool *budget_pool(int num_threads) {
+    pthread_once(&library_pool_once, library_pool_init);
+    if (num_threads >= online_cores()) {
+        return library_pool;
+    }
+    pthread_mutex_lock(&budget_pools_lock);
+    if (!budget_pools[num_threads]) {
+        budget_pools[num_threads] = pool_create(num_threads - 1);
+    }
+    thread_pool *pool = budget_pools[num_threads];
+    pthread_mutex_unlock(&budget_pools_lock);
+    return pool;
+}
+
+// one range of a parallel profile
+typedef struct {
+    const uint32_t *arr;
+    size_t size;
+    input_profile profile;
+} ProfileTask;
+
+static void profile_task(void *arg) {
+    ProfileTask *task = (ProfileTask *)arg;
+    profile_range(task->arr, task->size, &task->profile);
+}
+
+static void reverse_keys(uint32_t *arr, size_t size) {
+    for (size_t l = 0, h = size - 1; l < h; l++, h--) {
+        uint32_t swap = arr[l];
+        arr[l] = arr[h];
+        arr[h] = swap;
+    }
+}
+
+int libsort_cpu_features(void) {
+    static int features = -1;
+    if (features < 0) {
+        __builtin_cpu_init();
+        int found = 0;
+        if (__builtin_cpu_supports("avx2")) {
+            found |= LIBSORT_CPU_AVX2;
+        }
+        if (__builtin_cpu_supports("avx512f")) {
+            found |= LIBSORT_CPU_AVX512;
+        }
+        features = found;
+    }
+    return features;
+}
+
+libsort_engine libsort_select(size_t size, int num_threads) {
+    int features = libsort_cpu_features();
+    if (num_threads <= 0) {
+        num_threads = online_cores();
+    }
+
+    if (size <= SMALL_SORT) {
+        return LIBSORT_MERGE_TILED;
+    }
+    if (num_threads == 1 || size < PARALLEL_SORT) {
+        return (features & LIBSORT_CPU_AVX2) ? LIBSORT_RADIX_SIMD : LIBSORT_RADIX_MSD;
+    }
+    return LIBSORT_RADIX_PARALLEL;
+}
+
+// one read of the keys, split across the library pool when the budget allows
+void libsort_profile(const uint32_t *arr, size_t size, int num_threads, input_profile *profile) {
+    if (num_threads <= 0) {
+        num_threads = online_cores();
+    }
+
+    size_t chunks = (num_threads < online_cores()) ? (size_t)num_threads : (size_t)online_cores();
+    if (chunks > size / PROFILE_CHUNK) {
+        chunks = size / PROFILE_CHUNK;
+    }
+    if (chunks > MAX_PROFILE_CHUNKS) {
+        chunks = MAX_PROFILE_CHUNKS;
+    }
+
+    if (chunks <= 1) {
+        profile_range(arr, size, profile);
+    } else {
+        pthread_once(&library_pool_once, library_pool_init);
+
+        ProfileTask tasks[MAX_PROFILE_CHUNKS];
+        task_group group;
+        task_group_init(&group);
+        for (size_t c = 0; c < chunks; c++) {
+            size_t lo = size * c / chunks;
+            tasks[c].arr = arr + lo;
+            tasks[c].size = size * (c + 1) / chunks - lo;
+            if (c > 0) {
+                pool_submit(library_pool, &group, profile_task, &tasks[c]);
+            }
+        }
+        profile_task(&tasks[0]);
+        pool_wait(library_pool, &group);
+
+        *profile = tasks[0].profile;
+        for (size_t c = 1; c < chunks; c++) {
+            profile_combine(profile, &tasks[c].profile, arr, size * c / chunks);
+        }
+    }
+
+    profile_sample(arr, size, profile);
+}
+
+libsort_engine libsort_select_input(const input_profile *profile, int num_threads) {
+    size_t size = profile->size;
+    size_t range = (size_t)(profile->max - profile->min) + 1;
+    // ascending and descending runs alike, merge_runs reverses the descending ones
+    size_t runs = profile->turns / 2 + 1;
+    if (num_threads <= 0) {
+        num_threads = online_cores();
+    }
+
+    if (range <= COUNTING_RANGE && range <= size) {
+        return LIBSORT_COUNTING;
+    }
+    if (runs <= MAX_MERGE_RUNS) {
+        return LIBSORT_MERGE_RUNS;
+    }
+    if (size > SMALL_SORT && profile->sample_size == PROFILE_SAMPLE &&
+        profile->sample_distinct <= FEW_DISTINCT) {
+        return (num_threads > 1 && size >= PARALLEL_SORT) ? LIBSORT_MSD_PARALLEL : LIBSORT_RADIX_MSD;
+    }
+    return libsort_select(size, num_threads);
+}
+
+const char *libsort_engine_name(libsort_engine engine) {
+    switch (engine) {
+    case LIBSORT_RADIX_VANILLA:  return "radix_vanilla";
+    case LIBSORT_RADIX_SIMD:     return "radix_simd";
+    case LIBSORT_RADIX_SIMD_WC:  return "radix_simd_wc";
+    case LIBSORT_RADIX_PARALLEL: return "radix_parallel";
+    case LIBSORT_RADIX_MSD:      return "radix_msd";
+    case LIBSORT_MSD_PARALLEL:   return "msd_parallel";
+    case LIBSORT_MERGE_TILED:    return "merge_tiled";
+    case LIBSORT_MERGE_PARALLEL: return "merge_parallel";
+    case LIBSORT_MERGE_RUNS:     return "merge_runs";
+    case LIBSORT_COUNTING:       return "counting";
+    default:                     return "unknown";
+    }
+}
+
+// run one engine, the pool engines use the pool of the thread budget
+void libsort_sort_with(libsort_engine engine, uint32_t *arr, size_t size, int num_threads) {
+    if (size < 2) {
+        return;
+    }
+    if (num_threads <= 0) {
+        num_threads = online_cores();
+    }
+
+    // the SIMD radix engines are built with -mavx2, never run them on a CPU without
+    if ((engine == LIBSORT_RADIX_SIMD || engine == LIBSORT_RADIX_SIMD_WC) &&
+        !(libsort_cpu_features() & LIBSORT_CPU_AVX2)) {
+        engine = LIBSORT_RADIX_MSD;
+    }
+
+    thread_pool *pool = NULL;
+    if (engine == LIBSORT_MSD_PARALLEL || engine == LIBSORT_MERGE_PARALLEL) {
+        pool = budget_pool(num_threads);
+    }
+
+    switch (engine) {
+    case LIBSORT_RADIX_VANILLA:
+        radix_sort_vanilla(arr, size);
+        break;
+    case LIBSORT_RADIX_SIMD:
+        radix_sort_simd(arr, size);
+        break;
+    case LIBSORT_RADIX_SIMD_WC:
+        radix_sort_simd_wc(arr, size);
+        break;
+    case LIBSORT_RADIX_PARALLEL:
+        radix_sort_parallel(arr, size, num_threads);
+        break;
+    case LIBSORT_RADIX_MSD:
+        radix_msd_inplace(arr, size);
+        break;
+    case LIBSORT_MSD_PARALLEL:
+        radix_msd_parallel_pool(pool, arr, size);
+        break;
+    case LIBSORT_MERGE_TILED:
+        merge_sort_tiled(arr, size);
+        break;
+    case LIBSORT_MERGE_PARALLEL:
+        merge_sort_parallel(pool, arr, size);
+        break;
+    case LIBSORT_MERGE_RUNS:
+        merge_sort_runs(arr, size);
+        break;
+    case LIBSORT_COUNTING: {
+        // the counts take 8 bytes per value of the range, wide ranges go by size instead
+        input_profile profile;
+        profile_range(arr, size, &profile);
+        if ((size_t)(profile.max - profile.min) < COUNTING_RANGE) {
+            counting_sort_range(arr, size, profile.min, profile.max, num_threads);
+        } else {
+            libsort_sort_with(libsort_select(size, num_threads), arr, size, num_threads);
+        }
+        break;
+    }
+    default:
+        fprintf(stderr, "libsort: unknown engine %d\n", (int)engine);
+        exit(EXIT_FAILURE);
+    }
+}
+
+void libsort_sort(uint32_t *arr, size_t size, int num_threads) {
+    if (size < 2) {
+        return;
+    }
+    if (num_threads <= 0) {
+        num_threads = online_cores();
+    }
+
+    input_profile profile;
+    PERF_PHASE_BEGIN(profile_start);
+    libsort_profile(arr, size, num_threads, &profile);
+    PERF_PHASE_END(profile_start, "sort_array.profile", 0);
+
+    // ordered input costs the profile read (and the reverse)
+    if (profile.descents == 0) {
+        return;
+    }
+    if (profile.ascents == 0) {
+        reverse_keys(arr, size);
+        return;
+    }
+
+    libsort_engine engine = libsort_select_input(&profile, num_threads);
+    if (engine == LIBSORT_COUNTING) {
+        // the profile already found the range
+        counting_sort_range(arr, size, profile.min, profile.max, num_threads);
+        return;
+    }
+    libsort_sort_with(engine, arr, size, num_threads);
+}
+
+void sort_array(uint32_t *arr, size_t size) {
+    libsort_sort(arr, size, 0);
+}
@@ -0,0 +1,153 @@
+#ifndef LIBSORT_H
+#define LIBSORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "input_profile.h"
+#include "perf_counters.h"
+
+/* libsort: every sort engine of this repo behind one header
+ * each engine file still builds as its own benchmark program, compiled with
+ * -DLIBSORT it leaves out its main / sort_array and only exports the engine
+ * BUILD: ./build_libsort.sh (libsort.a and libsort.so)
+ * USE:   gcc -O3 -pthread app.c -L. -lsort
+ *
+ * sort_array (libsort.c) profiles the input (input_profile.h), returns sorted
+ * and reversed input after about one pass and picks an engine from the key
+ * range, the runs, the distinct keys, the input size, the CPU features and the
+ * thread budget, the engines below can also be called directly
+ * every engine sorts ascending in place (uint32_t keys unless the name says
+ * otherwise) and is safe to call from several threads at once (the pool
+ * engines may share one pool)
+ */
+
+typedef struct thread_pool thread_pool;
+
+// engines sort_array can choose from
+typedef enum {
+    LIBSORT_RADIX_VANILLA,   // base 10 LSD radix, reference only (never chosen)
+    LIBSORT_RADIX_SIMD,      // AVX2 LSD radix, one byte per pass (needs AVX2)
+    LIBSORT_RADIX_SIMD_WC,   // the same with write-combining scatter buffers, for comparison (never chosen)
+    LIBSORT_RADIX_PARALLEL,  // LSD radix, threads share every pass
+    LIBSORT_RADIX_MSD,       // in-place MSD radix (American flag), no scratch array
+    LIBSORT_MSD_PARALLEL,    // in-place MSD radix on the work-stealing pool
+    LIBSORT_MERGE_TILED,     // merge sort with sorting network tiles
+    LIBSORT_MERGE_PARALLEL,  // task based merge sort on the work-stealing pool
+    LIBSORT_MERGE_RUNS,      // natural merge sort, merges the runs already in the input
+    LIBSORT_COUNTING,        // parallel counting sort, for small key ranges
+    LIBSORT_NUM_ENGINES
+} libsort_engine;
+
+// CPU features seen by the dispatcher
+#define LIBSORT_CPU_AVX2   1
+#define LIBSORT_CPU_AVX512 2
+
+// radix_sorting_vanilla.c
+void radix_sort_vanilla(uint32_t *arr, size_t size);
+
+// radix_sorting_simd.c, the CPU must support AVX2
+void radix_sort_simd(uint32_t *arr, size_t size);
+// radix_sorting_simd.c built with -DWC_SCATTER=1
+void radix_sort_simd_wc(uint32_t *arr, size_t size);
+
+// radix_sorting_kv.c, 64 bit keys and keys with a payload moved in the same
+// passes (values[i] follows keys[i]), stable
+void radix_sort_u64(uint64_t *keys, size_t size);
+void radix_sort_u64_u32(uint64_t *keys, uint32_t *values, size_t size);
+void radix_sort_u64_u64(uint64_t *keys, uint64_t *values, size_t size);
+void radix_sort_u32_u32(uint32_t *keys, uint32_t *values, size_t size);
+void radix_sort_u32_u64(uint32_t *keys, uint64_t *values, size_t size);
+// signed and floating point keys, mapped to unsigned order inside the first and last pass
+// (-NaN < -inf < -0.0 < +0.0 < +inf < +NaN)
+void radix_sort_i32(int32_t *keys, size_t size);
+void radix_sort_i32_u32(int32_t *keys, uint32_t *values, size_t size);
+void radix_sort_f32(float *keys, size_t size);
+void radix_sort_f32_u32(float *keys, uint32_t *values, size_t size);
+void radix_sort_i64(int64_t *keys, size_t size);
+void radix_sort_i64_u32(int64_t *keys, uint32_t *values, size_t size);
+void radix_sort_f64(double *keys, size_t size);
+void radix_sort_f64_u32(double *keys, uint32_t *values, size_t size);
+// argsort: indices[j] is the position of the j-th smallest key (ties in input order),
+// size < 2^32, keys are only sorted as well when sort_keys is set
+void radix_argsort_u32(uint32_t *keys, uint32_t *indices, size_t size, int sort_keys);
+void radix_argsort_u64(uint64_t *keys, uint32_t *indices, size_t size, int sort_keys);
+void radix_argsort_i32(int32_t *keys, uint32_t *indices, size_t size, int sort_keys);
+void radix_argsort_f32(float *keys, uint32_t *indices, size_t size, int sort_keys);
+void radix_argsort_i64(int64_t *keys, uint32_t *indices, size_t size, int sort_keys);
+void radix_argsort_f64(double *keys, uint32_t *indices, size_t size, int sort_keys);
+
+// key types of a radix_sort_columns column
+typedef enum {
+    LIBSORT_KEY_U32,
+    LIBSORT_KEY_I32,
+    LIBSORT_KEY_F32,
+    LIBSORT_KEY_U64,
+    LIBSORT_KEY_I64,
+    LIBSORT_KEY_F64
+} libsort_key_type;
+
+// one column of a table, data holds size keys of the given type
+typedef struct {
+    const void *data;
+    libsort_key_type type;
+    int descending;     // largest keys first, ties still in row order
+} libsort_column;
+
+// composite sort: perm gets the row order sorted by columns[0], then columns[1], ...
+// stable, size < 2^32, the columns are not modified
+void radix_sort_columns(const libsort_column *columns, int num_columns, uint32_t *perm, size_t size);
+
+// radix_select.c, top-k by radix selection, the rest of arr ends in no particular order
+uint32_t radix_select(uint32_t *arr, size_t size, size_t n);         // key of rank n moved to arr[n], n < size
+void radix_select_k(uint32_t *arr, size_t size, size_t k, int sorted); // k smallest keys to arr[0..k)
+void radix_partial_sort(uint32_t *arr, size_t size, size_t k);       // radix_select_k, sorted
+
+// radix_threads.c, starts num_threads - 1 threads for the sort
+void radix_sort_parallel(uint32_t *arr, size_t size, int num_threads);
+
+// radix_msd_inplace.c
+void radix_msd_inplace(uint32_t *arr, size_t size);
+
+// radix_msd_parallel.c
+void radix_msd_parallel_pool(thread_pool *pool, uint32_t *arr, size_t size);
+void radix_msd_parallel(uint32_t *arr, size_t size, int num_threads);
+
+// merge_tile.c
+void merge_sort_tiled(uint32_t *arr, size_t size);
+
+// merge_parallel.c, num_threads counts the thread calling the sort
+thread_pool *merge_pool_create(int num_threads);
+void merge_pool_destroy(thread_pool *pool);
+void merge_sort_parallel(thread_pool *pool, uint32_t *arr, size_t size);
+
+// merge_runs.c
+void merge_sort_runs(uint32_t *arr, size_t size);
+
+// counting_sort.c, the counts take 8 bytes per value of [min, max] and thread
+void counting_sort(uint32_t *arr, size_t size, int num_threads);
+void counting_sort_range(uint32_t *arr, size_t size, uint32_t min, uint32_t max, int num_threads);
+
+// external_sort.c, sorts a binary uint32_t key file into output with about memory
+// bytes of buffers, 0 or -1 after an I/O error (errno set, EINVAL when output is
+// the input or the file isn't whole keys)
+int external_sort_file(const char *input, const char *output, size_t memory, int num_threads);
+
+// sort_file.c, sorts a 32 or 64 bit key file through mmap (mapped_file.h), into
+// output or in place when it is NULL, engine LIBSORT_NUM_ENGINES: sort_array's choice
+int libsort_sort_file(const char *input, const char *output, int key_bits,
+                      libsort_engine engine, int num_threads, int flags);
+
+// perf_counters.c, per phase counters of the single thread engines (perf_open,
+// perf_phases, see perf_counters.h), libsort is built with the hooks
+
+// libsort.c, dispatcher
+int libsort_cpu_features(void);                                      // LIBSORT_CPU_* bits
+libsort_engine libsort_select(size_t size, int num_threads);         // pick from size, CPU and threads only
+void libsort_profile(const uint32_t *arr, size_t size, int num_threads, input_profile *profile);
+libsort_engine libsort_select_input(const input_profile *profile, int num_threads); // engine sort_array would use
+const char *libsort_engine_name(libsort_engine engine);
+void libsort_sort_with(libsort_engine engine, uint32_t *arr, size_t size, int num_threads);
+void libsort_sort(uint32_t *arr, size_t size, int num_threads);      // num_threads <= 0: every core
+void sort_array(uint32_t *arr, size_t size);                         // every core
+
+#endif
@@ -0,0 +1,182 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdint.h>
+#include <stddef.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* Key files mapped into memory, so a sort works on the page cache directly
+ * instead of copying the file through read / write buffers
+ *   map_file     maps an existing file shared and writable, the sort runs in
+ *                place and the kernel writes the pages back
+ *   map_output   creates the output file at the input's size, fills it with
+ *                copy_file_range (inside the kernel, or a reflink on file systems
+ *                that share extents) and maps it the same way
+ * every mapping asks for MAP_POPULATE (the page faults are taken in one go
+ * before the sort instead of one per 4 KB inside it) and MADV_SEQUENTIAL
+ * (read ahead, the first pass of every engine reads the keys in order)
+ * MAP_FILE_HUGE asks for MAP_HUGETLB, which the kernel only grants for files on
+ * hugetlbfs, elsewhere the mapping falls back to normal pages with
+ * MADV_HUGEPAGE (taken on file systems with transparent huge page support)
+ * unmap_file syncs the pages (msync, fsync) before it lets go of them, so an
+ * error writing them back is returned instead of lost
+ * the functions return 0, or -1 with errno set
+ */
+
+#define MAP_FILE_HUGE 1  // try huge pages
+
+typedef struct {
+    void *data;
+    size_t bytes;
+    int fd;
+    int huge;   // mapped with MAP_HUGETLB
+} mapped_file;
+
+// map bytes of fd shared and writable, huge pages first when asked
+static inline int map_fd(int fd, size_t bytes, int flags, mapped_file *m) {
+    m->fd = fd;
+    m->bytes = bytes;
+    m->huge = 0;
+    m->data = NULL;
+    if (bytes == 0) {
+        // nothing to map, an empty file is sorted as it is
+        return 0;
+    }
+
+    void *data = MAP_FAILED;
+    if (flags & MAP_FILE_HUGE) {
+        data = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE | MAP_HUGETLB, fd, 0);
+        m->huge = data != MAP_FAILED;
+    }
+    if (data == MAP_FAILED) {
+        data = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    }
+    if (data == MAP_FAILED) {
+        return -1;
+    }
+
+    madvise(data, bytes, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+    if ((flags & MAP_FILE_HUGE) && !m->huge) {
+        madvise(data, bytes, MADV_HUGEPAGE);
+    }
+#endif
+    m->data = data;
+    return 0;
+}
+
+// map an existing file for sorting in place
+static inline int map_file(const char *path, int flags, mapped_file *m) {
+    int fd = open(path, O_RDWR);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || map_fd(fd, (size_t)info.st_size, flags, m) != 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    return 0;
+}
+
+// output holds a copy of input, mapped for sorting in place
+// an output that is the input itself (the same path, a link to it) is sorted
+// in place: truncating it first would lose the keys before they were read
+static inline int map_output(const char *input, const char *output, int flags, mapped_file *m) {
+    int in = open(input, O_RDONLY);
+    if (in < 0) {
+        return -1;
+    }
+    int out = -1;
+    struct stat info, out_info;
+    if (fstat(in, &info) != 0) {
+        goto fail;
+    }
+    if (stat(output, &out_info) == 0 && out_info.st_dev == info.st_dev && out_info.st_ino == info.st_ino) {
+        close(in);
+        return map_file(input, flags, m);
+    }
+    out = open(output, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (out < 0 || ftruncate(out, info.st_size) != 0) {
+        goto fail;
+    }
+
+    // the copy stays inside the kernel, files on different file systems (or
+    // kernels without copy_file_range) copy one mapping into the other instead
+    size_t bytes = (size_t)info.st_size;
+    size_t copied = 0;
+    while (copied < bytes) {
+        loff_t in_offset = (loff_t)copied;
+        loff_t out_offset = (loff_t)copied;
+        ssize_t done = copy_file_range(in, &in_offset, out, &out_offset, bytes - copied, 0);
+        if (done <= 0) {
+            break;
+        }
+        copied += (size_t)done;
+    }
+
+    if (map_fd(out, bytes, flags, m) != 0) {
+        goto fail;
+    }
+    if (copied < bytes) {
+        void *source = mmap(NULL, bytes, PROT_READ, MAP_PRIVATE | MAP_POPULATE, in, 0);
+        if (source == MAP_FAILED) {
+            munmap(m->data, bytes);
+            goto fail;
+        }
+        madvise(source, bytes, MADV_SEQUENTIAL);
+        memcpy((char *)m->data + copied, (char *)source + copied, bytes - copied);
+        munmap(source, bytes);
+    }
+    close(in);
+    return 0;
+
+fail: {
+        int saved = errno;
+        close(in);
+        if (out >= 0) {
+            close(out);
+        }
+        errno = saved;
+        return -1;
+    }
+}
+
+// write the dirty pages back, unmap and close, -1 with errno set (of the first
+// failure) when the write back failed, a full disk only shows up here
+static inline int unmap_file(mapped_file *m) {
+    int saved = 0;
+    if (m->data) {
+        if (msync(m->data, m->bytes, MS_SYNC) != 0) {
+            saved = errno;
+        }
+        if (munmap(m->data, m->bytes) != 0 && !saved) {
+            saved = errno;
+        }
+    }
+    // the size set by ftruncate and whatever msync left to the file system
+    if (fsync(m->fd) != 0 && !saved) {
+        saved = errno;
+    }
+    if (close(m->fd) != 0 && !saved) {
+        saved = errno;
+    }
+    m->data = NULL;
+    if (saved) {
+        errno = saved;
+        return -1;
+    }
+    return 0;
+}
+
+#endif
@@ -3,111 +3,214 @@
 #include <stdint.h>
 #include <time.h>
 #include <pthread.h>
-
-
-/* COMPILE: gcc -pthread merge_parallel.c -o merge_parallel
- * RUN: ./merge_parallel
+#include <unistd.h>
+#include <string.h>
+#include "sort_timing.h"
+#include "sort_data.h"
+#include "thread_pool.h"
+#include "bitonic_simd.h"
+#include "libsort.h"
+
+
+/* COMPILE: gcc -O3 -pthread merge_parallel.c -o merge_parallel
+ *          gcc -O3 -pthread -DLIBSORT -c merge_parallel.c (engine only, see libsort.h)
+ * RUN: ./merge_parallel [power] [threads]
+ * task based merge sort on a persistent work-stealing pool (thread_pool.h)
+ * the recursion forks the left half as a task down to GRAIN_SIZE and sorts the
+ * rest serially, all state is passed in so several sorts can share one pool
+ * large merges are split with merge path: co_rank (same binary search as sort.cu)
+ * finds where each equal sized output chunk starts in both inputs, so every merge
+ * level, including the final one over the whole array, runs on all threads
  */
 
+#define GRAIN_SIZE (1 << 14)  // ranges up to this size are sorted on one thread
+#define MAX_MERGE_CHUNKS 256  // most output chunks one merge is split into
 
-uint32_t *a;
-size_t MAX;
-uint32_t *aux; // Global auxiliary array
-
-static inline uint64_t rdtsc() {
-    unsigned long a, d;
-    asm volatile("rdtsc" : "=a"(a), "=d"(d));
-    return a | ((uint64_t)d << 32);
-}
+// one half of a split still to be sorted
+typedef struct {
+    thread_pool *pool;
+    uint32_t *a;
+    uint32_t *aux;
+    size_t l, h;
+} SortTask;
 
-void merge(size_t l, size_t m, size_t h) {
-    size_t i = l, j = m + 1, k = l;
+// one output chunk of a merge path merge (or of its copy back)
+typedef struct {
+    uint32_t *a;
+    uint32_t *aux;
+    size_t l, m, h;     // the merge, a[l..m] with a[m+1..h]
+    size_t k_lo, k_hi;  // output range of this chunk, relative to l
+} MergeTask;
 
-    // Merge the two halves into the auxiliary array
-    while (i <= m && j <= h) {
-        if (a[i] <= a[j]) {
-            aux[k++] = a[i++];
-        } else {
-            aux[k++] = a[j++];
-        }
-    }
-    while (i <= m) aux[k++] = a[i++];
-    while (j <= h) aux[k++] = a[j++];
+static void merge(uint32_t *a, uint32_t *aux, size_t l, size_t m, size_t h) {
+    // Merge the two halves into the auxiliary array (bitonic network, see bitonic_simd.h)
+    merge_simd(a + l, m - l + 1, a + m + 1, h - m, aux + l);
 
     // Copy back the merged elements into the original array
-    for (i = l; i <= h; i++) {
+    for (size_t i = l; i <= h; i++) {
         a[i] = aux[i];
     }
 }
 
-void merge_sort(size_t l, size_t h) {
+static void merge_sort(uint32_t *a, uint32_t *aux, size_t l, size_t h) {
     if (l < h) {
         size_t m = (l + h) / 2;
-        merge_sort(l, m);
-        merge_sort(m + 1, h);
-        merge(l, m, h);
+        merge_sort(a, aux, l, m);
+        merge_sort(a, aux, m + 1, h);
+        merge(a, aux, l, m, h);
     }
 }
 
-struct tsk {
-    size_t l, h;
-};
+// number of elements taken from A among the first k outputs of merging A (m) with B (n)
+// Adapted from sort.cu (Programming Massively Parallel Processors)
+static size_t co_rank(size_t k, const uint32_t *A, size_t m, const uint32_t *B, size_t n) {
+    size_t i = k < m ? k : m; // i = min(k, m)
+    size_t j = k - i;
+    size_t i_low = k > n ? k - n : 0;
+    size_t j_low = k > m ? k - m : 0;
+    size_t delta;
+
+    for (;;) {
+        if (i > 0 && j < n && A[i - 1] > B[j]) {
+            delta = ((i - i_low + 1) >> 1);
+            j_low = j;
+            j = j + delta;
+            i = i - delta;
+        } else if (j > 0 && i < m && B[j - 1] >= A[i]) {
+            delta = ((j - j_low + 1) >> 1);
+            i_low = i;
+            i = i + delta;
+            j = j - delta;
+        } else {
+            return i;
+        }
+    }
+}
+
+// merge the output range [k_lo, k_hi) of one merge into aux
+static void merge_chunk_task(void *arg) {
+    MergeTask *tsk = (MergeTask *)arg;
+    const uint32_t *A = tsk->a + tsk->l;
+    const uint32_t *B = tsk->a + tsk->m + 1;
+    size_t m = tsk->m - tsk->l + 1;
+    size_t n = tsk->h - tsk->m;
 
-struct tsk_m {
-    size_t l, h, m;
-};
+    size_t i_lo = co_rank(tsk->k_lo, A, m, B, n);
+    size_t i_hi = co_rank(tsk->k_hi, A, m, B, n);
+    size_t j_lo = tsk->k_lo - i_lo;
+    size_t j_hi = tsk->k_hi - i_hi;
 
-void *merge_sort_thread(void *arg) {
-    struct tsk *tsk = (struct tsk *)arg;
-    merge_sort(tsk->l, tsk->h);
-    return NULL;
+    merge_simd(A + i_lo, i_hi - i_lo, B + j_lo, j_hi - j_lo, tsk->aux + tsk->l + tsk->k_lo);
 }
 
-void *merge_sort_m(void *arg) {
-    struct tsk_m *tsk = (struct tsk_m *)arg;
-    merge(tsk->l, tsk->m, tsk->h);
-    return NULL;
+// copy the output range [k_lo, k_hi) of one merge back into a
+static void copy_chunk_task(void *arg) {
+    MergeTask *tsk = (MergeTask *)arg;
+    memcpy(tsk->a + tsk->l + tsk->k_lo, tsk->aux + tsk->l + tsk->k_lo,
+           (tsk->k_hi - tsk->k_lo) * sizeof(uint32_t));
 }
 
-void sort_array(uint32_t *arr, size_t size) {
-    size_t num_threads = 16, N;
+// merge a[l..m] with a[m+1..h] split into equal output chunks across the pool
+static void parallel_merge(thread_pool *pool, uint32_t *a, uint32_t *aux, size_t l, size_t m, size_t h) {
+    size_t total = h - l + 1;
+    size_t chunks = pool->num_workers + 1;
+    if (chunks > total / GRAIN_SIZE) {
+        chunks = total / GRAIN_SIZE;
+    }
+    if (chunks > MAX_MERGE_CHUNKS) {
+        chunks = MAX_MERGE_CHUNKS;
+    }
+    if (chunks <= 1) {
+        merge(a, aux, l, m, h);
+        return;
+    }
 
-    N = num_threads;
+    MergeTask tasks[MAX_MERGE_CHUNKS];
+    for (size_t c = 0; c < chunks; c++) {
+        MergeTask tsk = { a, aux, l, m, h, total * c / chunks, total * (c + 1) / chunks };
+        tasks[c] = tsk;
+    }
 
-    pthread_t threads[N];
-    struct tsk tsklist[N];
-    struct tsk_m mlist[N];
-    size_t p = MAX / N, l = 0;
+    // every chunk reads anywhere in a[l..h], so all merges finish before the copy back
+    task_group group;
+    task_group_init(&group);
+    for (size_t c = 1; c < chunks; c++) {
+        pool_submit(pool, &group, merge_chunk_task, &tasks[c]);
+    }
+    merge_chunk_task(&tasks[0]);
+    pool_wait(pool, &group);
 
-    for (size_t i = 0; i < N; i++, l += p) {
-        tsklist[i].l = l;
-        tsklist[i].h = (i == N - 1) ? MAX - 1 : l + p - 1;
+    for (size_t c = 1; c < chunks; c++) {
+        pool_submit(pool, &group, copy_chunk_task, &tasks[c]);
     }
+    copy_chunk_task(&tasks[0]);
+    pool_wait(pool, &group);
+}
 
-    for (size_t i = 0; i < N; i++)
-        pthread_create(&threads[i], NULL, merge_sort_thread, &tsklist[i]);
+static void merge_sort_task(void *arg);
 
-    for (size_t i = 0; i < N; i++)
-        pthread_join(threads[i], NULL);
+static void parallel_merge_sort(thread_pool *pool, uint32_t *a, uint32_t *aux, size_t l, size_t h) {
+    if (h - l + 1 <= GRAIN_SIZE) {
+        merge_sort(a, aux, l, h);
+        return;
+    }
 
-    for (int j = 2; j <= num_threads; j *= 2) {
-        l = 0;
-        N = num_threads / j;
-        p = MAX / N;
+    size_t m = l + (h - l) / 2;
 
-        for (size_t i = 0; i < N; i++, l += p) {
-            mlist[i].l = l;
-            mlist[i].h = (i == N - 1) ? MAX - 1 : l + p - 1;
-            mlist[i].m = (mlist[i].h + mlist[i].l) / 2;
-        }
+    // fork the left half, sort the right half here, then join
+    task_group group;
+    task_group_init(&group);
+    SortTask left = { pool, a, aux, l, m };
+    pool_submit(pool, &group, merge_sort_task, &left);
+    parallel_merge_sort(pool, a, aux, m + 1, h);
+    pool_wait(pool, &group);
 
-        for (size_t i = 0; i < N; i++) {
-            pthread_create(&threads[i], NULL, merge_sort_m, &mlist[i]);
-        }
-        for (size_t i = 0; i < N; i++) {
-            pthread_join(threads[i], NULL);
-        }
+    parallel_merge(pool, a, aux, l, m, h);
+}
+
+static void merge_sort_task(void *arg) {
+    SortTask *tsk = (SortTask *)arg;
+    parallel_merge_sort(tsk->pool, tsk->a, tsk->aux, tsk->l, tsk->h);
+}
+
+// pool for merge_sort_parallel, num_threads counts the thread calling the sort
+thread_pool *merge_pool_create(int num_threads) {
+    return pool_create(num_threads - 1);
+}
+
+void merge_pool_destroy(thread_pool *pool) {
+    pool_destroy(pool);
+}
+
+// reentrant parallel merge sort, any number of threads may sort on the same pool at once
+void merge_sort_parallel(thread_pool *pool, uint32_t *arr, size_t size) {
+    if (size < 2) {
+        return;
+    }
+
+    uint32_t *aux = malloc(size * sizeof(uint32_t)); // auxiliary array of this sort
+    if (!aux) {
+        perror("Failed to allocate memory for auxiliary array");
+        exit(EXIT_FAILURE);
     }
+
+    parallel_merge_sort(pool, arr, aux, 0, size - 1);
+
+    free(aux);
+}
+
+#ifndef LIBSORT
+// process wide pool used by sort_array, created on first use
+static thread_pool *default_pool;
+static pthread_once_t default_pool_once = PTHREAD_ONCE_INIT;
+
+static void default_pool_init(void) {
+    default_pool = merge_pool_create((int)sysconf(_SC_NPROCESSORS_ONLN));
+}
+
+void sort_array(uint32_t *arr, size_t size) {
+    pthread_once(&default_pool_once, default_pool_init);
+    merge_sort_parallel(default_pool, arr, size);
 }
 
 void print_array(uint32_t *arr, size_t size) {
@@ -117,49 +220,45 @@ void print_array(uint32_t *arr, size_t size) {
     printf("\n");
 }
 
-int main() {
-    size_t size = 1 << 22; // Example: Allocate space for 2^22 elements
+int main(int argc, char *argv[]) {
+    // optional array size as a power of two and thread count
+    int power = (argc > 1) ? atoi(argv[1]) : 22;
+    int num_threads = (argc > 2) ? atoi(argv[2]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    size_t size = (size_t)1 << power; // Example: Allocate space for 2^22 elements
     uint32_t *sorted_arr = malloc(size * sizeof(uint32_t));
     if (!sorted_arr) {
         perror("Failed to allocate memory");
         exit(EXIT_FAILURE);
     }
 
-    aux = malloc(size * sizeof(uint32_t)); // Allocate the auxiliary array
-    if (!aux) {
-        perror("Failed to allocate memory for auxiliary array");
-        free(sorted_arr);
-        exit(EXIT_FAILURE);
-    }
+    data_spec keys = data_spec_of(DATA_UNIFORM);
+    keys.range = 100;
+    data_fill_u32(sorted_arr, size, keys, (uint64_t)time(NULL), 0);
+    data_checksum checksum = data_checksum_u32(sorted_arr, size, 0);
 
-    srand((unsigned)time(NULL));
-    for (size_t i = 0; i < size; i++)
-        sorted_arr[i] = ((rand() % 100) + 1);
-
-    MAX = size;
-    a = sorted_arr;
+    // the pool outlives the sort, a service would keep it for every request
+    thread_pool *pool = merge_pool_create(num_threads);
 
     uint64_t start, end, time;
 
-    start = rdtsc();
-    sort_array(sorted_arr, size);
-    end = rdtsc();
+    start = rdtsc_start();
+    merge_sort_parallel(pool, sorted_arr, size);
+    end = rdtsc_stop();
     time = end - start;
 
-    printf("Sort time: %llu cycles\n", time);
+    printf("Sort time: " TIMING_FMT "\n", TIMING_ARGS(time, size));
 
-    for (size_t i = 1; i < size; i++) {
-        if (sorted_arr[i - 1] > sorted_arr[i] ) {
-            printf("Simd sorting failed.\n");
-            free(sorted_arr);
-            return 1;
-        }
+    if (!data_verify_u32(sorted_arr, size, checksum, 0)) {
+        printf("Simd sorting failed.\n");
+        free(sorted_arr);
+        return 1;
     }
 
     // Uncomment to print the array
     // print_array(sorted_arr, size);
 
+    merge_pool_destroy(pool);
     free(sorted_arr);
-    free(aux); // Free the auxiliary array
     return 0;
 }
+#endif
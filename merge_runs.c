@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <string.h>
+#include "sort_timing.h"
+#include "sort_data.h"
+#include "bitonic_simd.h"
+#include "perf_counters.h"
+#include "libsort.h"
+
+/* Natural merge sort for presorted input
+ * one scan splits the input into its ascending runs (strictly descending runs
+ * are reversed in place), then neighbouring runs are merged pairwise with the
+ * bitonic merge until one run is left, so k runs cost about log2(k) merge
+ * passes: a sorted input is one read, a reversed one a read and a write
+ * COMPILE: gcc -O3 -pthread merge_runs.c -o merge_runs
+ *          gcc -O3 -DSORT_PERF=1 merge_runs.c perf_counters.c -o merge_runs_perf (counters per merge pass)
+ *          gcc -O3 -DLIBSORT -c merge_runs.c (engine only, see libsort.h)
+ * RUN: ./merge_runs [power] [runs]
+ * the input is [runs] sorted runs of random keys (default 16)
+ */
+
+static void reverse(uint32_t *arr, size_t l, size_t h) {
+    while (l < h) {
+        uint32_t swap = arr[l];
+        arr[l++] = arr[h];
+        arr[h--] = swap;
+    }
+}
+
+#define INITIAL_RUNS 64 // run starts allocated up front, doubled when the input has more
+
+// split arr into runs, run r is [starts[r], starts[r + 1]), returns the run count
+// *starts holds *capacity entries and grows with the runs found (this engine is
+// picked for inputs with few runs, so size / 2 entries up front would mostly sit unused)
+static size_t find_runs(uint32_t *arr, size_t size, size_t **starts, size_t *capacity) {
+    size_t runs = 0;
+    size_t i = 0;
+
+    while (i < size) {
+        size_t start = i++;
+        if (i < size && arr[i - 1] > arr[i]) {
+            // strictly descending run, reversed it is ascending
+            while (i < size && arr[i - 1] > arr[i]) {
+                i++;
+            }
+            reverse(arr, start, i - 1);
+        } else {
+            while (i < size && arr[i - 1] <= arr[i]) {
+                i++;
+            }
+        }
+
+        // a reversed run can continue the run before it
+        if (runs > 0 && arr[start - 1] <= arr[start]) {
+            continue;
+        }
+        // one entry stays free for the end of the last run
+        if (runs + 2 > *capacity) {
+            size_t *grown = realloc(*starts, *capacity * 2 * sizeof(size_t));
+            if (!grown) {
+                perror("Failed to allocate memory for run starts");
+                exit(EXIT_FAILURE);
+            }
+            *starts = grown;
+            *capacity *= 2;
+        }
+        (*starts)[runs++] = start;
+    }
+    (*starts)[runs] = size;
+    return runs;
+}
+
+// natural merge sort
+void merge_sort_runs(uint32_t *arr, size_t size) {
+    if (size < 2) {
+        return;
+    }
+
+    size_t capacity = INITIAL_RUNS;
+    size_t *starts = malloc(capacity * sizeof(size_t));
+    if (!starts) {
+        perror("Failed to allocate memory for run starts");
+        exit(EXIT_FAILURE);
+    }
+
+    PERF_PHASE_BEGIN(scan_start);
+    size_t runs = find_runs(arr, size, &starts, &capacity);
+    PERF_PHASE_END(scan_start, "merge_runs.scan", 0);
+    if (runs == 1) {
+        // sorted (or reversed) input
+        free(starts);
+        return;
+    }
+
+    uint32_t *aux = malloc(size * sizeof(uint32_t));
+    if (!aux) {
+        perror("Failed to allocate memory for auxiliary array");
+        exit(EXIT_FAILURE);
+    }
+
+    // merge neighbouring runs, ping-ponging between arr and aux
+    uint32_t *src = arr;
+    uint32_t *dst = aux;
+    int level = 0; // merge pass, for the phase counters (perf_counters.h)
+    while (runs > 1) {
+        PERF_PHASE_BEGIN(merge_start);
+        size_t merged = 0;
+        size_t r = 0;
+        for (; r + 1 < runs; r += 2) {
+            size_t lo = starts[r];
+            size_t mid = starts[r + 1];
+            size_t hi = starts[r + 2];
+            merge_simd(src + lo, mid - lo, src + mid, hi - mid, dst + lo);
+            starts[merged++] = lo;
+        }
+        if (r < runs) {
+            // odd run out, carried over to the next level
+            memcpy(dst + starts[r], src + starts[r], (size - starts[r]) * sizeof(uint32_t));
+            starts[merged++] = starts[r];
+        }
+        starts[merged] = size;
+        runs = merged;
+        PERF_PHASE_END(merge_start, "merge_runs.merge", level);
+        level++;
+
+        uint32_t *swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    if (src != arr) {
+        memcpy(arr, src, size * sizeof(uint32_t));
+    }
+
+    free(aux);
+    free(starts);
+}
+
+#ifndef LIBSORT
+void sort_array(uint32_t *arr, size_t size) {
+    merge_sort_runs(arr, size);
+}
+
+static int compare_keys(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[]) {
+    // optional array size as a power of two and number of sorted runs in the input
+    int power = (argc > 1) ? atoi(argv[1]) : 22;
+    size_t runs = (argc > 2) ? (size_t)atol(argv[2]) : 16;
+    size_t size = (size_t)1 << power;
+    if (runs < 1) {
+        runs = 1;
+    }
+
+    uint32_t *arr = malloc(size * sizeof(uint32_t));
+    if (!arr) {
+        perror("Failed to allocate array");
+        exit(EXIT_FAILURE);
+    }
+
+    // runs of random keys, each sorted on its own
+    data_fill_u32(arr, size, data_spec_of(DATA_UNIFORM), (uint64_t)time(NULL), 0);
+    data_checksum checksum = data_checksum_u32(arr, size, 0);
+    for (size_t r = 0; r < runs; r++) {
+        size_t lo = size * r / runs;
+        size_t hi = size * (r + 1) / runs;
+        qsort(arr + lo, hi - lo, sizeof(uint32_t), compare_keys);
+    }
+
+    uint64_t start, end, time;
+
+#if SORT_PERF
+    perf_open();
+#endif
+    start = rdtsc_start();
+    sort_array(arr, size);
+    end = rdtsc_stop();
+    time = end - start;
+#if SORT_PERF
+    // phase breakdown on stderr, stdout keeps its format
+    perf_print(stderr);
+    perf_close();
+#endif
+
+    printf("Run merge sort time (%zu runs): " TIMING_FMT "\n", runs, TIMING_ARGS(time, size));
+
+    if (!data_verify_u32(arr, size, checksum, 0)) {
+        printf("Run merge sorting failed.\n");
+        free(arr);
+        return 1;
+    }
+
+    free(arr);
+    return 0;
+}
+#endif
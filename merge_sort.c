@@ -2,17 +2,13 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <time.h>
+#include "sort_timing.h"
+#include "sort_data.h"
 
-/* COMPILE: gcc merge_sort.c -o merge_sort
+/* COMPILE: gcc -pthread merge_sort.c -o merge_sort
  * RUN: ./merge_sort
  */
 
-static inline uint64_t rdtsc() {
-	unsigned long a, d;
-	asm volatile("rdtsc" : "=a"(a), "=d"(d));
-	return a | ((uint64_t)d << 32);
-}
-
 void merge(uint32_t *arr, size_t l, size_t m, size_t h) {
     size_t n1 = m - l + 1, n2 = h - m;
     size_t *L = malloc(n1 * sizeof(size_t));
@@ -63,28 +59,25 @@ int main() {
 		perror("Failed to allocate memory");
     		exit(EXIT_FAILURE);
 	}
-	srand((unsigned)time(NULL)); // Seed the random number generator
-	for (size_t i = 0; i < size; i++)
-		sorted_arr[i] = rand();
+	data_fill_u32(sorted_arr, size, data_spec_of(DATA_UNIFORM), (uint64_t)time(NULL), 0);
+	data_checksum checksum = data_checksum_u32(sorted_arr, size, 0);
 
 
     // declare variables for timing
     uint64_t start, end, time;
 
-    start = rdtsc();
+    start = rdtsc_start();
     // Sort the copied array
     sort_array(sorted_arr, size);
-    end = rdtsc();
+    end = rdtsc_stop();
     time = end - start;
 
-    printf("Sort time: %llu cycles\n", time);
+    printf("Sort time: " TIMING_FMT "\n", TIMING_ARGS(time, size));
 
-    for (size_t i = 1; i < size; i++) {
-        if (sorted_arr[i - 1] > sorted_arr[i] ) {
-            printf("Simd sorting failed.\n");
-            free(sorted_arr);
-            return 1;
-        }
+    if (!data_verify_u32(sorted_arr, size, checksum, 0)) {
+        printf("Simd sorting failed.\n");
+        free(sorted_arr);
+        return 1;
     }
 
 
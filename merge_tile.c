@@ -2,25 +2,35 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <time.h>
-
-
-/* COMPILE: gcc merge_tile.c -o merge_tile
+#include <string.h>
+#include "sort_timing.h"
+#include "sort_data.h"
+#include "bitonic_simd.h"
+#include "perf_counters.h"
+#include "libsort.h"
+
+
+/* COMPILE: gcc -pthread merge_tile.c -o merge_tile
+ *          gcc -DTILE_SIZE=128 merge_tile.c -o merge_tile (tile size, 64 or a multiple of it suits the network)
+ *          gcc -DLEAF_NETWORK=0 merge_tile.c -o merge_tile (insertion sort leaves)
+ *          gcc -O3 -DSORT_PERF=1 merge_tile.c perf_counters.c -o merge_tile_perf (counters per merge level)
+ *          gcc -O3 -DLIBSORT -c merge_tile.c (engine only, see libsort.h)
  * RUN: ./merge_tile
+ * main also reports the cycles per key of both leaf sorts on the same tiles
  */
 
-#define TILE_SIZE 32 // Threshold for tiling
+#ifndef TILE_SIZE
+#define TILE_SIZE 64 // Threshold for tiling
+#endif
 
-uint32_t *aux; // Auxiliary array for merging
-size_t MAX;
-
-static inline uint64_t rdtsc() {
-    unsigned long a, d;
-    asm volatile("rdtsc" : "=a"(a), "=d"(d));
-    return a | ((uint64_t)d << 32);
-}
+// LEAF_NETWORK 1: sort tiles with the AVX2 sorting network (sort_network in bitonic_simd.h)
+// LEAF_NETWORK 0: sort tiles with insertion sort
+#ifndef LEAF_NETWORK
+#define LEAF_NETWORK 1
+#endif
 
 // Iterative sorting for small tiles (Insertion Sort)
-void insertion_sort(uint32_t *arr, size_t l, size_t h) {
+static void insertion_sort(uint32_t *arr, size_t l, size_t h) {
     for (size_t i = l + 1; i <= h; i++) {
         uint32_t key = arr[i];
         size_t j = i;
@@ -32,57 +42,113 @@ void insertion_sort(uint32_t *arr, size_t l, size_t h) {
     }
 }
 
-// Merge two sorted halves
-void merge(uint32_t *arr, size_t l, size_t m, size_t h) {
-    size_t i = l, j = m + 1, k = l;
-
-    // Merge into the auxiliary array
-    while (i <= m && j <= h) {
-        if (arr[i] <= arr[j]) {
-            aux[k++] = arr[i++];
-        } else {
-            aux[k++] = arr[j++];
-        }
+// Sort one tile arr[l..h], aux[l..h] is free to use as scratch
+static void tile_sort(uint32_t *arr, uint32_t *aux, size_t l, size_t h) {
+#if LEAF_NETWORK
+    if (sort_network(arr + l, h - l + 1, aux + l)) {
+        return;
     }
-    while (i <= m) aux[k++] = arr[i++];
-    while (j <= h) aux[k++] = arr[j++];
+#endif
+    // no AVX2 (or network disabled), sort small subarray using insertion sort
+    insertion_sort(arr, l, h);
+}
+
+// Merge two sorted halves
+static void merge(uint32_t *arr, uint32_t *aux, size_t l, size_t m, size_t h) {
+    // Merge into the auxiliary array (branch free bitonic network, see bitonic_simd.h)
+    merge_simd(arr + l, m - l + 1, arr + m + 1, h - m, aux + l);
 
     // Copy back to the original array
-    for (i = l; i <= h; i++) {
+    for (size_t i = l; i <= h; i++) {
         arr[i] = aux[i];
     }
 }
 
 // Recursive merge sort with tiling optimization
-void tiled_merge_sort(uint32_t *arr, size_t l, size_t h) {
+// depth 0 is the last merge, the merges of the first PERF_MERGE_LEVELS levels
+// go to the phase counters one level at a time and the subtrees below them as one phase
+static void tiled_merge_sort(uint32_t *arr, uint32_t *aux, size_t l, size_t h, int depth) {
+#if SORT_PERF
+    if (depth == PERF_MERGE_LEVELS || (depth < PERF_MERGE_LEVELS && h - l + 1 <= TILE_SIZE)) {
+        PERF_PHASE_BEGIN(subtree_start);
+        tiled_merge_sort(arr, aux, l, h, PERF_MERGE_LEVELS + 1);
+        PERF_PHASE_END(subtree_start, "merge_tiled.subtrees", depth);
+        return;
+    }
+#endif
     if (h - l + 1 <= TILE_SIZE) {
-        // Sort small subarray using insertion sort
-        insertion_sort(arr, l, h);
+        // Sort small subarray in registers
+        tile_sort(arr, aux, l, h);
         return;
     }
 
     size_t m = l + (h - l) / 2;
 
     // Recursive calls for left and right halves
-    tiled_merge_sort(arr, l, m);
-    tiled_merge_sort(arr, m + 1, h);
+    tiled_merge_sort(arr, aux, l, m, depth + 1);
+    tiled_merge_sort(arr, aux, m + 1, h, depth + 1);
 
     // Merge the two sorted halves
-    merge(arr, l, m, h);
+    PERF_PHASE_BEGIN_IF(depth < PERF_MERGE_LEVELS, merge_start);
+    merge(arr, aux, l, m, h);
+    PERF_PHASE_END_IF(depth < PERF_MERGE_LEVELS, merge_start, "merge_tiled.merge", depth);
 }
 
-void sort_array(uint32_t *arr, size_t size) {
-    aux = malloc(size * sizeof(uint32_t)); // Allocate auxiliary array
+// tiled merge sort, the auxiliary array belongs to the call so sorts can run concurrently
+void merge_sort_tiled(uint32_t *arr, size_t size) {
+    if (size < 2) {
+        return;
+    }
+
+    uint32_t *aux = malloc(size * sizeof(uint32_t)); // Allocate auxiliary array
     if (!aux) {
         perror("Failed to allocate auxiliary array");
         exit(EXIT_FAILURE);
     }
 
-    tiled_merge_sort(arr, 0, size - 1);
+    tiled_merge_sort(arr, aux, 0, size - 1, 0);
 
     free(aux); // Free auxiliary array
 }
 
+#ifndef LIBSORT
+void sort_array(uint32_t *arr, size_t size) {
+    merge_sort_tiled(arr, size);
+}
+
+// cycles per key of the insertion sort leaf and the sorting network leaf on the same tiles
+void benchmark_leaves(uint32_t *arr, size_t size) {
+    uint32_t *copy = malloc(size * sizeof(uint32_t));
+    uint32_t *aux = malloc(size * sizeof(uint32_t));
+    if (!copy || !aux) {
+        perror("Failed to allocate benchmark arrays");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(copy, arr, size * sizeof(uint32_t));
+
+    uint64_t start = rdtsc_start();
+    for (size_t l = 0; l + TILE_SIZE <= size; l += TILE_SIZE) {
+        insertion_sort(copy, l, l + TILE_SIZE - 1);
+    }
+    uint64_t insertion_time = rdtsc_stop() - start;
+
+    memcpy(copy, arr, size * sizeof(uint32_t));
+    start = rdtsc_start();
+    for (size_t l = 0; l + TILE_SIZE <= size; l += TILE_SIZE) {
+        if (!sort_network(copy + l, TILE_SIZE, aux + l)) {
+            insertion_sort(copy, l, l + TILE_SIZE - 1);
+        }
+    }
+    uint64_t network_time = rdtsc_stop() - start;
+
+    printf("Leaf sort (tiles of %d): insertion %.2f cycles/key (%.2f ns/key), network %.2f cycles/key (%.2f ns/key)\n",
+           TILE_SIZE, (double)insertion_time / size, timing_ns(insertion_time) / size,
+           (double)network_time / size, timing_ns(network_time) / size);
+
+    free(aux);
+    free(copy);
+}
+
 void print_array(uint32_t *arr, size_t size) {
     for (size_t i = 0; i < size; i++) {
         printf("%u ", arr[i]);
@@ -98,27 +164,34 @@ int main() {
         exit(EXIT_FAILURE);
     }
 
-    srand((unsigned)time(NULL));
-    for (size_t i = 0; i < size; i++) {
-        arr[i] = rand();
-    }
+    data_fill_u32(arr, size, data_spec_of(DATA_UNIFORM), (uint64_t)time(NULL), 0);
+    data_checksum checksum = data_checksum_u32(arr, size, 0);
+
+    // compare the two leaf sorts before the full sort
+    benchmark_leaves(arr, size);
 
     // Declare variables for timing
     uint64_t start, end, time;
 
-    start = rdtsc();
+#if SORT_PERF
+    perf_open();
+#endif
+    start = rdtsc_start();
     sort_array(arr, size);
-    end = rdtsc();
+    end = rdtsc_stop();
     time = end - start;
-
-    printf("Sort time: %llu cycles\n", time);
-
-    for (size_t i = 1; i < size; i++) {
-        if (arr[i - 1] > arr[i] ) {
-            printf("Simd sorting failed.\n");
-            free(arr);
-            return 1;
-        }
+#if SORT_PERF
+    // phase breakdown on stderr, stdout keeps its format
+    perf_print(stderr);
+    perf_close();
+#endif
+
+    printf("Sort time: " TIMING_FMT "\n", TIMING_ARGS(time, size));
+
+    if (!data_verify_u32(arr, size, checksum, 0)) {
+        printf("Simd sorting failed.\n");
+        free(arr);
+        return 1;
     }
 
     // Uncomment to print the array
@@ -126,4 +199,5 @@ int main() {
 
     free(arr);
     return 0;
-}
\ No newline at end of file
+}
+#endif
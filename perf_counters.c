@@ -0,0 +1,202 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "sort_timing.h"
+#include "perf_counters.h"
+
+/* perf_event_open counters behind the phase hooks (see perf_counters.h)
+ * the events open as one group on the calling thread, so a phase costs two
+ * read() calls of all counters at once and every event covers the same
+ * instructions, the state is per thread so sorts on other threads (and their
+ * hooks) are left alone
+ * COMPILE: gcc -O3 -DLIBSORT -c perf_counters.c (part of libsort)
+ */
+
+#define CACHE_MISS(cache) ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | \
+                           (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static const struct {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+} events[PERF_NUM_EVENTS] = {
+    { "cycles",        PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { "instructions",  PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { "llc_misses",    PERF_TYPE_HW_CACHE, CACHE_MISS(PERF_COUNT_HW_CACHE_LL) },
+    { "dtlb_misses",   PERF_TYPE_HW_CACHE, CACHE_MISS(PERF_COUNT_HW_CACHE_DTLB) },
+    { "branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+};
+
+typedef struct {
+    int active;
+    int leader;                  // fd of the group, -1 without hardware events
+    int fds[PERF_NUM_EVENTS];
+    int slot[PERF_NUM_EVENTS];   // position of the event in a group read, -1 if missing
+    int opened;
+    perf_phase phases[PERF_MAX_PHASES];
+    size_t num_phases;
+} perf_state;
+
+static __thread perf_state perf;
+
+// one event of the group, with the kernel's share if the paranoia level allows
+static int open_event(int event, int group) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = events[event].type;
+    attr.config = events[event].config;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.exclude_hv = 1;
+
+    int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+    if (fd < 0) {
+        attr.exclude_kernel = 1;
+        fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+    }
+    return fd;
+}
+
+int perf_open(void) {
+    if (perf.active) {
+        perf_close();
+    }
+    memset(&perf, 0, sizeof(perf));
+    perf.leader = -1;
+    for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+        perf.fds[e] = open_event(e, perf.leader);
+        perf.slot[e] = -1;
+        if (perf.fds[e] >= 0) {
+            if (perf.leader < 0) {
+                perf.leader = perf.fds[e];
+            }
+            perf.slot[e] = perf.opened++;
+        }
+    }
+    perf.active = 1;
+    return perf.opened;
+}
+
+void perf_close(void) {
+    if (!perf.active) {
+        return;
+    }
+    for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+        if (perf.fds[e] >= 0) {
+            close(perf.fds[e]);
+            perf.fds[e] = -1;
+        }
+    }
+    perf.leader = -1;
+    perf.active = 0;
+}
+
+int perf_active(void) {
+    return perf.active;
+}
+
+void perf_reset(void) {
+    perf.num_phases = 0;
+}
+
+size_t perf_phases(const perf_phase **phases) {
+    *phases = perf.phases;
+    return perf.num_phases;
+}
+
+const char *perf_event_name(perf_event event) {
+    return events[event].name;
+}
+
+// every counter of the group in one read
+static void read_counters(perf_sample *sample) {
+    uint64_t buffer[3 + PERF_NUM_EVENTS];
+    memset(sample->value, 0, sizeof(sample->value));
+    sample->enabled = sample->running = 0;
+    if (perf.leader < 0 || read(perf.leader, buffer, sizeof(buffer)) < (ssize_t)(3 * sizeof(uint64_t))) {
+        return;
+    }
+    // nr, time enabled, time running, then the values in the order they were added
+    sample->enabled = buffer[1];
+    sample->running = buffer[2];
+    for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+        if (perf.slot[e] >= 0 && (uint64_t)perf.slot[e] < buffer[0]) {
+            sample->value[e] = buffer[3 + perf.slot[e]];
+        }
+    }
+}
+
+void perf_begin(perf_sample *start) {
+    if (!perf.active) {
+        return;
+    }
+    read_counters(start);
+    start->tsc = rdtsc_start();
+}
+
+void perf_end(const perf_sample *start, const char *name, int level) {
+    if (!perf.active) {
+        return;
+    }
+    uint64_t tsc = rdtsc_stop();
+    perf_sample end;
+    read_counters(&end);
+
+    perf_phase *phase = NULL;
+    for (size_t p = 0; p < perf.num_phases; p++) {
+        if (perf.phases[p].level == level && strcmp(perf.phases[p].name, name) == 0) {
+            phase = &perf.phases[p];
+            break;
+        }
+    }
+    if (!phase) {
+        if (perf.num_phases == PERF_MAX_PHASES) {
+            return;
+        }
+        phase = &perf.phases[perf.num_phases++];
+        memset(phase, 0, sizeof(*phase));
+        phase->name = name;
+        phase->level = level;
+        for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+            phase->count[e] = perf.slot[e] >= 0 ? 0 : PERF_MISSING;
+        }
+    }
+
+    // scaled up when the PMU only ran the group for part of the phase
+    uint64_t enabled = end.enabled - start->enabled;
+    uint64_t running = end.running - start->running;
+    double scale = (running > 0 && running < enabled) ? (double)enabled / running : 1.0;
+    phase->calls++;
+    phase->tsc += tsc - start->tsc;
+    for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+        if (perf.slot[e] >= 0) {
+            phase->count[e] += (uint64_t)((end.value[e] - start->value[e]) * scale);
+        }
+    }
+}
+
+// the table as text, for the benchmark mains built with -DSORT_PERF=1
+void perf_print(FILE *out) {
+    fprintf(out, "%-28s %5s %6s %14s", "phase", "level", "calls", "tsc cycles");
+    for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+        fprintf(out, " %14s", events[e].name);
+    }
+    fprintf(out, "\n");
+    for (size_t p = 0; p < perf.num_phases; p++) {
+        const perf_phase *phase = &perf.phases[p];
+        fprintf(out, "%-28s %5d %6lu %14lu", phase->name, phase->level, phase->calls, phase->tsc);
+        for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+            if (phase->count[e] == PERF_MISSING) {
+                fprintf(out, " %14s", "-");
+            } else {
+                fprintf(out, " %14lu", phase->count[e]);
+            }
+        }
+        fprintf(out, "\n");
+    }
+}
@@ -0,0 +1,101 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Per phase hardware counters of the sort engines (perf_counters.c)
+ * perf_open opens one perf_event_open group on the calling thread:
+ *   cycles, instructions, LLC misses, dTLB misses, branch misses
+ * and from then on every phase an engine brackets with PERF_PHASE_BEGIN /
+ * PERF_PHASE_END on that thread adds its counts (and its TSC cycles) to a
+ * table of (phase, level) rows:
+ *   radix_simd     histogram_<kernel> (the fused read of all 4 bytes, named
+ *                  after the kernel radix_histogram.h picked), prefix and
+ *                  scatter, level = the byte of the pass
+ *   radix_vanilla  histogram, prefix, scatter and copy, level = the digit
+ *   radix_msd      histogram, prefix and permute of the top byte, then the
+ *                  recursion into the buckets as one phase
+ *   merge_tiled    every merge of level 0 (the last one, whole array) down to
+ *                  PERF_MERGE_LEVELS - 1, the subtrees below as one phase
+ *   merge_runs     the run scan, then every merge pass, level = the pass
+ *   sort_array     the input profile
+ * the counters are per thread, the parallel engines would only be counted on
+ * the thread that called them so they have no phases
+ * events the CPU or the kernel doesn't offer (virtual machines often have no
+ * PMU, perf_event_paranoid may rule out the kernel's share) are left out and
+ * read as PERF_MISSING, the TSC cycles of the phases are always there
+ * the hooks only exist in files compiled with -DSORT_PERF=1 (build_libsort.sh
+ * builds libsort with them, off until perf_open), without it they are empty
+ * and perf_counters.c isn't needed
+ * sort_bench -P writes the table of every configuration, the benchmark mains
+ * of the engines above print theirs when built with the hooks:
+ * COMPILE: gcc -O3 -mavx2 -DSORT_PERF=1 radix_sorting_simd.c perf_counters.c
+ */
+
+#ifndef SORT_PERF
+#define SORT_PERF 0
+#endif
+
+#define PERF_MERGE_LEVELS 8 // merge levels of merge_tiled counted one by one
+#define PERF_MAX_PHASES 64  // rows of the phase table
+#define PERF_MISSING UINT64_MAX
+
+typedef enum {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_LLC_MISSES,
+    PERF_DTLB_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_NUM_EVENTS
+} perf_event;
+
+// counter values at the start of a phase
+typedef struct {
+    uint64_t tsc;
+    uint64_t value[PERF_NUM_EVENTS];
+    uint64_t enabled, running; // for groups the PMU had to multiplex
+} perf_sample;
+
+// one row of the phase table, totals over every call
+typedef struct {
+    const char *name;
+    int level;
+    uint64_t calls;
+    uint64_t tsc;
+    uint64_t count[PERF_NUM_EVENTS]; // PERF_MISSING for events that didn't open
+} perf_phase;
+
+// open the counters on the calling thread and clear its table, returns the
+// number of hardware events that opened (0 still times the phases)
+int perf_open(void);
+void perf_close(void);
+int perf_active(void);
+// clear the table, the counters stay open
+void perf_reset(void);
+// the table of the calling thread, in the order the phases first ran
+size_t perf_phases(const perf_phase **phases);
+const char *perf_event_name(perf_event event);
+// the table of the calling thread as text, one line per phase
+void perf_print(FILE *out);
+
+// phase hooks, only active between perf_open and perf_close
+void perf_begin(perf_sample *start);
+void perf_end(const perf_sample *start, const char *name, int level);
+
+// the _IF forms only read the counters when cond holds (the top level of a
+// recursion), so the calls below it don't pay two group reads each
+#if SORT_PERF
+#define PERF_PHASE_BEGIN(sample) perf_sample sample; perf_begin(&sample)
+#define PERF_PHASE_END(sample, name, level) perf_end(&sample, name, level)
+#define PERF_PHASE_BEGIN_IF(cond, sample) perf_sample sample; if (cond) perf_begin(&sample)
+#define PERF_PHASE_END_IF(cond, sample, name, level) do { if (cond) perf_end(&sample, name, level); } while (0)
+#else
+#define PERF_PHASE_BEGIN(sample)
+#define PERF_PHASE_END(sample, name, level)
+#define PERF_PHASE_BEGIN_IF(cond, sample)
+#define PERF_PHASE_END_IF(cond, sample, name, level)
+#endif
+
+#endif
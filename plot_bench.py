@@ -0,0 +1,56 @@
+import sys
+import pandas as pd
+import matplotlib.pyplot as plt
+
+# Plots of sort_bench results (CSV or JSON, same columns)
+# python3 plot_bench.py results.csv              one ns/key and one GB/s plot per distribution
+# python3 plot_bench.py results.csv baseline.csv also lists the configurations whose median
+#                                                ns/key got more than THRESHOLD slower
+
+THRESHOLD = 0.05
+KEYS = ['engine', 'distribution', 'threads', 'power']
+
+
+def load(path):
+    if path.endswith('.json'):
+        return pd.read_json(path)
+    return pd.read_csv(path)
+
+
+def plot(results):
+    for distribution, rows in results.groupby('distribution'):
+        for column, label, name in [('ns_per_key', 'Median ns per key', 'ns'),
+                                    ('gb_per_s', 'GB/s of keys sorted', 'gbs')]:
+            plt.figure(figsize=(8, 6))
+            plt.rcParams.update({'font.size': 14})
+            for (engine, threads), series in rows.groupby(['engine', 'threads']):
+                series = series.sort_values('power')
+                plt.plot(series['power'], series[column], marker='o', label=f'{engine} ({threads}t)')
+            plt.xlabel('Array Size (2^n)', fontsize=16)
+            plt.ylabel(label, fontsize=16)
+            plt.title(f'{distribution} keys', fontsize=18)
+            plt.grid(True)
+            plt.legend(fontsize=9)
+            plt.savefig(f'bench_{distribution}_{name}.png', bbox_inches='tight')
+            plt.close()
+
+
+def compare(results, baseline):
+    merged = pd.merge(results, baseline, on=KEYS, suffixes=('', '_baseline'))
+    merged['change'] = merged['ns_per_key'] / merged['ns_per_key_baseline'] - 1
+    slower = merged[merged['change'] > THRESHOLD].sort_values('change', ascending=False)
+    for _, row in slower.iterrows():
+        print(f"{row['engine']:16} {row['distribution']:11} {row['threads']:3}t 2^{row['power']:<3}"
+              f" {row['ns_per_key_baseline']:8.3f} -> {row['ns_per_key']:8.3f} ns/key ({row['change']:+.1%})")
+    print(f'{len(slower)} of {len(merged)} configurations slower by more than {THRESHOLD:.0%}')
+    return len(slower)
+
+
+if __name__ == '__main__':
+    if len(sys.argv) < 2:
+        print('usage: plot_bench.py results.csv|json [baseline.csv|json]')
+        sys.exit(1)
+    results = load(sys.argv[1])
+    plot(results)
+    if len(sys.argv) > 2:
+        sys.exit(1 if compare(results, load(sys.argv[2])) else 0)
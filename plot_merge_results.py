@@ -0,0 +1,55 @@
+import pandas as pd
+import matplotlib.pyplot as plt
+
+# merge sort plots from the sort_bench results of run_tests.sh (uniform keys),
+# the tiled merge sort against the natural merge sort on one thread and the
+# task based merge sort on every thread of the sweep
+results = pd.read_csv('bench_results.csv')
+results = results[results['distribution'] == 'uniform']
+threads = results[results['engine'] == 'merge_parallel']['threads'].max()
+
+
+def engine(name, threads):
+    rows = results[(results['engine'] == name) & (results['threads'] == threads)]
+    return rows[['power', 'cycles_median']].rename(columns={'cycles_median': 'cycles_' + name})
+
+
+medians = engine('merge_tiled', 1)
+medians = pd.merge(medians, engine('merge_runs', 1), on='power')
+medians = pd.merge(medians, engine('merge_parallel', threads), on='power')
+medians = medians.sort_values('power').reset_index(drop=True)
+medians['speedup_parallel'] = medians['cycles_merge_tiled'] / medians['cycles_merge_parallel']
+medians['speedup_runs'] = medians['cycles_merge_runs'] / medians['cycles_merge_tiled']
+
+# Create bar plot for cycles
+plt.figure(figsize=(10, 6))
+plt.rcParams.update({'font.size': 14})
+x = range(len(medians))
+width = 0.25
+
+plt.bar(x, medians['cycles_merge_runs'], width, label='Natural (runs)')
+plt.bar([i + width for i in x], medians['cycles_merge_tiled'], width, label='Tile')
+plt.bar([i + 2 * width for i in x], medians['cycles_merge_parallel'], width, label=f'Thread ({threads}t)')
+
+plt.xlabel('Array Size (2^n)', fontsize=16)
+plt.ylabel('Median Cycles', fontsize=16)
+plt.title('MergeSort Variations Comparison', fontsize=18)
+plt.xticks([i + width for i in x], [f'2^{power}' for power in medians['power']])
+plt.yscale('log')
+plt.legend()
+plt.grid(True)
+plt.savefig('merge_comparison.png', bbox_inches='tight')
+plt.close()
+
+# Create speedup plot
+plt.figure(figsize=(8, 6))
+plt.plot(medians['power'], medians['speedup_parallel'], marker='o', label='Thread over Tile')
+plt.plot(medians['power'], medians['speedup_runs'], marker='o', label='Tile over Natural (runs)')
+plt.axhline(1.0, color='gray', linestyle='--')
+plt.xlabel('Array Size (2^n)', fontsize=16)
+plt.ylabel('Speedup (x faster)', fontsize=16)
+plt.title('MergeSort Speedup vs Array Size', fontsize=18)
+plt.grid(True)
+plt.legend()
+plt.savefig('merge_speedup.png')
+plt.close()
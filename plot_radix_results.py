@@ -1,63 +1,68 @@
 import pandas as pd
 import matplotlib.pyplot as plt
-import seaborn as sns
 
-# Read both CSV files
-simd_df = pd.read_csv('simd_results.csv')
-vanilla_df = pd.read_csv('vanilla_results.csv')
+# SIMD vs vanilla radix plots from the sort_bench results of run_tests.sh
+# (uniform keys, one thread), with the write-combining scatter (radix_simd_wc)
+# against the direct scatter of radix_simd
+results = pd.read_csv('bench_results.csv')
+results = results[(results['distribution'] == 'uniform') & (results['threads'] == 1)]
 
-# Calculate medians for each size
-simd_medians = simd_df.groupby('power').agg({
-    'cycles': 'median'
-}).reset_index()
-vanilla_medians = vanilla_df.groupby('power').agg({
-    'cycles': 'median'
-}).reset_index()
 
-# Calculate speedup
-medians = pd.merge(simd_medians, vanilla_medians, on='power', suffixes=('_simd', '_vanilla'))
-medians['speedup'] = medians['cycles_vanilla'] / medians['cycles_simd']
+def engine(name):
+    return results[results['engine'] == name][['power', 'cycles_median']].rename(
+        columns={'cycles_median': 'cycles_' + name})
 
-# Create bar plot for cycles (log scale)
-plt.figure(figsize=(8, 6))
-plt.rcParams.update({'font.size': 14})
-x = range(len(medians))
-width = 0.35
 
-plt.bar(x, medians['cycles_simd'], width, label='SIMD')
-plt.bar([i + width for i in x], medians['cycles_vanilla'], width, label='Vanilla')
+medians = engine('radix_simd')
+for name in ['radix_simd_wc', 'radix_vanilla', 'radix_msd']:
+    medians = pd.merge(medians, engine(name), on='power')
+medians = medians.sort_values('power').reset_index(drop=True)
+medians['speedup'] = medians['cycles_radix_vanilla'] / medians['cycles_radix_simd']
+medians['speedup_msd'] = medians['cycles_radix_msd'] / medians['cycles_radix_simd']
+medians['speedup_wc'] = medians['cycles_radix_simd'] / medians['cycles_radix_simd_wc']
 
-plt.xlabel('Array Size (2^n)', fontsize=16)
-plt.ylabel('Median Cycles', fontsize=16)
-plt.title('Sorting Performance Comparison', fontsize=18)
-plt.xticks([i + width/2 for i in x], [f'2^{power}' for power in medians['power']])
-plt.legend()
-plt.yscale('log')
-plt.savefig('performance_comparison.png')
-plt.close()
+# Create bar plot for cycles (log scale and linear)
+for log in [True, False]:
+    plt.figure(figsize=(8, 6))
+    plt.rcParams.update({'font.size': 14})
+    x = range(len(medians))
+    width = 0.2
 
-# Create non-logarithmic bar plot for cycles
-plt.figure(figsize=(8, 6))
-x = range(len(medians))
-width = 0.35
+    plt.bar(x, medians['cycles_radix_simd'], width, label='SIMD')
+    plt.bar([i + width for i in x], medians['cycles_radix_simd_wc'], width, label='SIMD write-combining')
+    plt.bar([i + 2 * width for i in x], medians['cycles_radix_msd'], width, label='MSD in place')
+    plt.bar([i + 3 * width for i in x], medians['cycles_radix_vanilla'], width, label='Vanilla')
 
-plt.bar(x, medians['cycles_simd'], width, label='SIMD')
-plt.bar([i + width for i in x], medians['cycles_vanilla'], width, label='Vanilla')
+    plt.xlabel('Array Size (2^n)', fontsize=16)
+    plt.ylabel('Median Cycles', fontsize=16)
+    plt.title('Sorting Performance Comparison' + ('' if log else ' (Linear Scale)'), fontsize=18)
+    plt.xticks([i + 1.5 * width for i in x], [f'2^{power}' for power in medians['power']])
+    plt.legend()
+    if log:
+        plt.yscale('log')
+    plt.savefig('performance_comparison.png' if log else 'performance_comparison_linear.png')
+    plt.close()
 
+# Create speedup plot
+plt.figure(figsize=(8, 6))
+plt.plot(medians['power'], medians['speedup'], marker='o', label='over vanilla')
+plt.plot(medians['power'], medians['speedup_msd'], marker='o', label='over MSD in place')
+plt.axhline(1.0, color='gray', linestyle='--')
 plt.xlabel('Array Size (2^n)', fontsize=16)
-plt.ylabel('Median Cycles', fontsize=16)
-plt.title('Sorting Performance Comparison (Linear Scale)', fontsize=18)
-plt.xticks([i + width/2 for i in x], [f'2^{power}' for power in medians['power']])
+plt.ylabel('Speedup (x faster)', fontsize=16)
+plt.title('SIMD Speedup vs Array Size', fontsize=18)
+plt.grid(True)
 plt.legend()
-plt.savefig('performance_comparison_linear.png')
+plt.savefig('speedup.png')
 plt.close()
 
-# Create speedup plot
+# write-combining scatter over the direct scatter, above 1 where the buffers pay off
 plt.figure(figsize=(8, 6))
-plt.plot(medians['power'], medians['speedup'], marker='o')
+plt.plot(medians['power'], medians['speedup_wc'], marker='o')
+plt.axhline(1.0, color='gray', linestyle='--')
 plt.xlabel('Array Size (2^n)', fontsize=16)
 plt.ylabel('Speedup (x faster)', fontsize=16)
-plt.title('SIMD Speedup vs Array Size', fontsize=18)
+plt.title('Write-Combining vs Direct Scatter', fontsize=18)
 plt.grid(True)
-plt.savefig('speedup.png')
-plt.close()
\ No newline at end of file
+plt.savefig('speedup_wc.png')
+plt.close()
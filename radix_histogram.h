@@ -0,0 +1,465 @@
+#ifndef RADIX_HISTOGRAM_H
+#define RADIX_HISTOGRAM_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <immintrin.h>
+
+/* Byte histogram kernels for the 256 bucket radix sorts
+ * every kernel counts into several interleaved sub-histograms that are merged
+ * at the end, so repeated digits never chain increments through the same
+ * counter (no store-to-load forwarding stalls)
+ *   scalar: 4 sub-histograms, 4 keys per iteration
+ *   avx2:   8 sub-histograms, one per vector lane
+ *   avx512: gather / add / scatter with vpconflictd resolving duplicate digits,
+ *           alternating between 4 sub-histograms
+ * the kernel is picked once at runtime among the ones CPUID reports as supported,
+ * RADIX_HISTOGRAM=scalar|avx2|avx512 in the environment overrides the choice
+ * (under pthread_once, libsort.c holds the one choice of every library engine)
+ * counts are uint32_t, so one call handles at most 2^32 - 1 keys, histogram_wide
+ * counts larger arrays in chunks of 2^31 keys into size_t counts
+ * histogram_all_bytes counts all 4 bytes in one read (the LSD engines), with
+ * its own scalar / avx2 (byte shuffle transpose) / avx512 (gather / scatter per
+ * byte) kernels picked the same way, into size_t counts
+ */
+
+#define HIST_RADIX 256
+#define HIST_MASK (HIST_RADIX - 1)
+
+typedef void (*histogram_fn)(const uint32_t *arr, size_t size, int shift, uint32_t *counts);
+
+// add the sub-histograms together into counts
+static inline void histogram_merge(uint32_t (*sub)[HIST_RADIX], int copies, uint32_t *counts) {
+    for (int b = 0; b < HIST_RADIX; b++) {
+        uint32_t total = 0;
+        for (int c = 0; c < copies; c++) {
+            total += sub[c][b];
+        }
+        counts[b] = total;
+    }
+}
+
+// portable kernel, 4 keys per iteration into 4 sub-histograms
+static inline void histogram_scalar(const uint32_t *arr, size_t size, int shift, uint32_t *counts) {
+    uint32_t sub[4][HIST_RADIX] __attribute__((aligned(64)));
+    memset(sub, 0, sizeof(sub));
+
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+        sub[0][(arr[i] >> shift) & HIST_MASK]++;
+        sub[1][(arr[i + 1] >> shift) & HIST_MASK]++;
+        sub[2][(arr[i + 2] >> shift) & HIST_MASK]++;
+        sub[3][(arr[i + 3] >> shift) & HIST_MASK]++;
+    }
+    for (; i < size; i++) {
+        sub[0][(arr[i] >> shift) & HIST_MASK]++;
+    }
+
+    histogram_merge(sub, 4, counts);
+}
+
+// AVX2 has no scatter, so extract the 8 digits with one vector op and give
+// every lane its own sub-histogram
+__attribute__((target("avx2")))
+static inline void histogram_avx2(const uint32_t *arr, size_t size, int shift, uint32_t *counts) {
+    uint32_t sub[8][HIST_RADIX] __attribute__((aligned(64)));
+    uint32_t digits[8] __attribute__((aligned(32)));
+    memset(sub, 0, sizeof(sub));
+
+    __m256i mask = _mm256_set1_epi32(HIST_MASK);
+    __m128i count = _mm_cvtsi32_si128(shift);
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        __m256i elements = _mm256_loadu_si256((const __m256i *)&arr[i]);
+        __m256i byte = _mm256_and_si256(_mm256_srl_epi32(elements, count), mask);
+        _mm256_store_si256((__m256i *)digits, byte);
+
+        sub[0][digits[0]]++;
+        sub[1][digits[1]]++;
+        sub[2][digits[2]]++;
+        sub[3][digits[3]]++;
+        sub[4][digits[4]]++;
+        sub[5][digits[5]]++;
+        sub[6][digits[6]]++;
+        sub[7][digits[7]]++;
+    }
+    for (; i < size; i++) {
+        sub[0][(arr[i] >> shift) & HIST_MASK]++;
+    }
+
+    histogram_merge(sub, 8, counts);
+}
+
+// per lane population count of the 16 bit vpconflictd masks
+__attribute__((target("avx512f")))
+static inline __m512i histogram_popcnt16(__m512i x) {
+    x = _mm512_sub_epi32(x, _mm512_and_si512(_mm512_srli_epi32(x, 1), _mm512_set1_epi32(0x5555)));
+    x = _mm512_add_epi32(_mm512_and_si512(x, _mm512_set1_epi32(0x3333)),
+                         _mm512_and_si512(_mm512_srli_epi32(x, 2), _mm512_set1_epi32(0x3333)));
+    x = _mm512_and_si512(_mm512_add_epi32(x, _mm512_srli_epi32(x, 4)), _mm512_set1_epi32(0x0F0F));
+    return _mm512_and_si512(_mm512_add_epi32(x, _mm512_srli_epi32(x, 8)), _mm512_set1_epi32(0x1F));
+}
+
+// AVX-512 gather / scatter histogram, vpconflictd gives every lane the lanes
+// before it with the same digit, so lane k adds 1 + (earlier duplicates) and the
+// last duplicate (scatters are ordered low to high lane) stores the full count
+__attribute__((target("avx512f,avx512cd")))
+static inline void histogram_avx512(const uint32_t *arr, size_t size, int shift, uint32_t *counts) {
+    uint32_t sub[4][HIST_RADIX] __attribute__((aligned(64)));
+    memset(sub, 0, sizeof(sub));
+
+    __m512i mask = _mm512_set1_epi32(HIST_MASK);
+    __m512i one = _mm512_set1_epi32(1);
+    __m128i count = _mm_cvtsi32_si128(shift);
+
+    size_t i = 0;
+    int c = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m512i elements = _mm512_loadu_si512((const void *)&arr[i]);
+        __m512i byte = _mm512_and_si512(_mm512_srl_epi32(elements, count), mask);
+
+        __m512i conflicts = _mm512_conflict_epi32(byte);
+        __m512i increment = _mm512_add_epi32(histogram_popcnt16(conflicts), one);
+
+        // rotate through the sub-histograms so back to back iterations don't
+        // wait on each other's scatter
+        uint32_t *table = sub[c];
+        c = (c + 1) & 3;
+        __m512i old = _mm512_i32gather_epi32(byte, table, 4);
+        _mm512_i32scatter_epi32(table, byte, _mm512_add_epi32(old, increment), 4);
+    }
+    for (; i < size; i++) {
+        sub[0][(arr[i] >> shift) & HIST_MASK]++;
+    }
+
+    histogram_merge(sub, 4, counts);
+}
+
+// pick a kernel: the AVX-512 gather/scatter kernel only pays off on cores with
+// fast scatter, so every kernel the CPU supports is timed once on a small
+// synthetic buffer and the fastest one wins
+static inline histogram_fn histogram_select(void) {
+    const char *force = getenv("RADIX_HISTOGRAM");
+    __builtin_cpu_init();
+
+    int has_avx2 = __builtin_cpu_supports("avx2");
+    int has_avx512 = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512cd");
+
+    if (force) {
+        if (strcmp(force, "scalar") == 0) return histogram_scalar;
+        if (strcmp(force, "avx2") == 0 && has_avx2) return histogram_avx2;
+        if (strcmp(force, "avx512") == 0 && has_avx512) return histogram_avx512;
+    }
+
+    histogram_fn candidates[3];
+    int num_candidates = 0;
+    candidates[num_candidates++] = histogram_scalar;
+    if (has_avx2) candidates[num_candidates++] = histogram_avx2;
+    if (has_avx512) candidates[num_candidates++] = histogram_avx512;
+
+    // 16K keys stay in L1/L2, so this measures the kernel and not memory
+    enum { CALIBRATION_KEYS = 1 << 14 };
+    uint32_t *sample = malloc(CALIBRATION_KEYS * sizeof(uint32_t));
+    if (!sample) {
+        return candidates[num_candidates - 1];
+    }
+    uint32_t x = 2463534242u;
+    for (size_t i = 0; i < CALIBRATION_KEYS; i++) {
+        x ^= x << 13; x ^= x >> 17; x ^= x << 5; // xorshift32
+        sample[i] = x;
+    }
+
+    uint32_t counts[HIST_RADIX];
+    histogram_fn best = candidates[0];
+    uint64_t best_time = UINT64_MAX;
+    for (int k = 0; k < num_candidates; k++) {
+        candidates[k](sample, CALIBRATION_KEYS, 0, counts); // warm up
+        uint64_t start = __rdtsc();
+        candidates[k](sample, CALIBRATION_KEYS, 0, counts);
+        candidates[k](sample, CALIBRATION_KEYS, 8, counts);
+        uint64_t time = __rdtsc() - start;
+        if (time < best_time) {
+            best_time = time;
+            best = candidates[k];
+        }
+    }
+    free(sample);
+    return best;
+}
+
+// kernel picked by histogram_select, set once by the first histogram_byte
+#ifdef LIBSORT
+// defined once in libsort.c, so the engines of the library share one selection
+extern pthread_once_t histogram_once;
+extern histogram_fn histogram_kernel;
+#else
+static pthread_once_t histogram_once = PTHREAD_ONCE_INIT;
+static histogram_fn histogram_kernel = NULL;
+#endif
+
+static inline void histogram_init(void) {
+    histogram_kernel = histogram_select();
+}
+
+// histogram of the byte at bit offset shift, dispatched on first use
+static inline void histogram_byte(const uint32_t *arr, size_t size, int shift, uint32_t *counts) {
+    pthread_once(&histogram_once, histogram_init);
+    histogram_kernel(arr, size, shift, counts);
+}
+
+// histogram_byte for any size, the chunks are added up in size_t counts
+static inline void histogram_wide(const uint32_t *arr, size_t size, int shift, size_t *counts) {
+    uint32_t part[HIST_RADIX];
+    memset(counts, 0, HIST_RADIX * sizeof(size_t));
+    for (size_t start = 0; start < size; start += (size_t)1 << 31) {
+        size_t count = (size - start > ((size_t)1 << 31)) ? (size_t)1 << 31 : size - start;
+        histogram_byte(arr + start, count, shift, part);
+        for (int b = 0; b < HIST_RADIX; b++) {
+            counts[b] += part[b];
+        }
+    }
+}
+
+// histograms of all four bytes in one read of the input, the multiset of keys
+// never changes between LSD passes so these are valid for every pass
+typedef void (*histogram_all_fn)(const uint32_t *arr, size_t size, uint32_t (*counts)[HIST_RADIX]);
+
+// portable kernel, two copies per byte keep neighbouring keys from chaining on
+// the same counter
+static inline void histogram_all_scalar(const uint32_t *arr, size_t size, uint32_t (*counts)[HIST_RADIX]) {
+    uint32_t sub[2][4][HIST_RADIX] __attribute__((aligned(64)));
+    memset(sub, 0, sizeof(sub));
+
+    size_t i = 0;
+    for (; i + 2 <= size; i += 2) {
+        uint32_t a = arr[i], b = arr[i + 1];
+        sub[0][0][a & HIST_MASK]++;
+        sub[0][1][(a >> 8) & HIST_MASK]++;
+        sub[0][2][(a >> 16) & HIST_MASK]++;
+        sub[0][3][a >> 24]++;
+        sub[1][0][b & HIST_MASK]++;
+        sub[1][1][(b >> 8) & HIST_MASK]++;
+        sub[1][2][(b >> 16) & HIST_MASK]++;
+        sub[1][3][b >> 24]++;
+    }
+    for (; i < size; i++) {
+        uint32_t a = arr[i];
+        sub[0][0][a & HIST_MASK]++;
+        sub[0][1][(a >> 8) & HIST_MASK]++;
+        sub[0][2][(a >> 16) & HIST_MASK]++;
+        sub[0][3][a >> 24]++;
+    }
+
+    for (int digit = 0; digit < 4; digit++) {
+        for (int b = 0; b < HIST_RADIX; b++) {
+            counts[digit][b] = sub[0][digit][b] + sub[1][digit][b];
+        }
+    }
+}
+
+// AVX2: one byte shuffle per 8 keys turns each 128 bit half (4 keys x 4 bytes)
+// into 4 bytes x 4 keys, so the digits of one byte sit next to each other,
+// even and odd keys count into their own sub-histograms (like the scalar kernel,
+// more copies only pushed each other out of L1)
+__attribute__((target("avx2")))
+static inline void histogram_all_avx2(const uint32_t *arr, size_t size, uint32_t (*counts)[HIST_RADIX]) {
+    uint32_t sub[2][4][HIST_RADIX] __attribute__((aligned(64)));
+    uint8_t digits[32] __attribute__((aligned(32)));
+    memset(sub, 0, sizeof(sub));
+
+    __m256i transpose = _mm256_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15,
+                                         0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        __m256i elements = _mm256_loadu_si256((const __m256i *)&arr[i]);
+        _mm256_store_si256((__m256i *)digits, _mm256_shuffle_epi8(elements, transpose));
+
+        for (int half = 0; half < 32; half += 16) {
+            for (int digit = 0; digit < 4; digit++) {
+                const uint8_t *d = &digits[half + 4 * digit];
+                sub[0][digit][d[0]]++;
+                sub[1][digit][d[1]]++;
+                sub[0][digit][d[2]]++;
+                sub[1][digit][d[3]]++;
+            }
+        }
+    }
+    for (; i < size; i++) {
+        uint32_t a = arr[i];
+        sub[0][0][a & HIST_MASK]++;
+        sub[0][1][(a >> 8) & HIST_MASK]++;
+        sub[0][2][(a >> 16) & HIST_MASK]++;
+        sub[0][3][a >> 24]++;
+    }
+
+    for (int digit = 0; digit < 4; digit++) {
+        for (int b = 0; b < HIST_RADIX; b++) {
+            counts[digit][b] = sub[0][digit][b] + sub[1][digit][b];
+        }
+    }
+}
+
+// AVX-512: the gather / vpconflictd / scatter of histogram_avx512 for every
+// byte of the same 16 keys, alternating between 2 sub-histograms per byte
+__attribute__((target("avx512f,avx512cd")))
+static inline void histogram_all_avx512(const uint32_t *arr, size_t size, uint32_t (*counts)[HIST_RADIX]) {
+    uint32_t sub[2][4][HIST_RADIX] __attribute__((aligned(64)));
+    memset(sub, 0, sizeof(sub));
+
+    __m512i mask = _mm512_set1_epi32(HIST_MASK);
+    __m512i one = _mm512_set1_epi32(1);
+
+    size_t i = 0;
+    int c = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m512i elements = _mm512_loadu_si512((const void *)&arr[i]);
+        for (int digit = 0; digit < 4; digit++) {
+            __m512i byte = _mm512_and_si512(_mm512_srl_epi32(elements, _mm_cvtsi32_si128(8 * digit)), mask);
+            __m512i increment = _mm512_add_epi32(histogram_popcnt16(_mm512_conflict_epi32(byte)), one);
+            uint32_t *table = sub[c][digit];
+            __m512i old = _mm512_i32gather_epi32(byte, table, 4);
+            _mm512_i32scatter_epi32(table, byte, _mm512_add_epi32(old, increment), 4);
+        }
+        c ^= 1;
+    }
+    for (; i < size; i++) {
+        uint32_t a = arr[i];
+        sub[0][0][a & HIST_MASK]++;
+        sub[0][1][(a >> 8) & HIST_MASK]++;
+        sub[0][2][(a >> 16) & HIST_MASK]++;
+        sub[0][3][a >> 24]++;
+    }
+
+    for (int digit = 0; digit < 4; digit++) {
+        for (int b = 0; b < HIST_RADIX; b++) {
+            counts[digit][b] = sub[0][digit][b] + sub[1][digit][b];
+        }
+    }
+}
+
+// pick the fused kernel the same way as histogram_select, timed on the same
+// kind of buffer, name is set to "scalar", "avx2" or "avx512"
+static inline histogram_all_fn histogram_all_select(const char **name) {
+    const char *force = getenv("RADIX_HISTOGRAM");
+    __builtin_cpu_init();
+
+    int has_avx2 = __builtin_cpu_supports("avx2");
+    int has_avx512 = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512cd");
+
+    histogram_all_fn candidates[3];
+    const char *names[3];
+    int num_candidates = 0;
+    candidates[num_candidates] = histogram_all_scalar;
+    names[num_candidates++] = "scalar";
+    if (has_avx2) {
+        candidates[num_candidates] = histogram_all_avx2;
+        names[num_candidates++] = "avx2";
+    }
+    if (has_avx512) {
+        candidates[num_candidates] = histogram_all_avx512;
+        names[num_candidates++] = "avx512";
+    }
+
+    if (force) {
+        for (int k = 0; k < num_candidates; k++) {
+            if (strcmp(force, names[k]) == 0) {
+                *name = names[k];
+                return candidates[k];
+            }
+        }
+    }
+
+    enum { CALIBRATION_KEYS = 1 << 14 };
+    uint32_t *sample = malloc(CALIBRATION_KEYS * sizeof(uint32_t));
+    if (!sample) {
+        *name = names[num_candidates - 1];
+        return candidates[num_candidates - 1];
+    }
+    uint32_t x = 2463534242u;
+    for (size_t i = 0; i < CALIBRATION_KEYS; i++) {
+        x ^= x << 13; x ^= x >> 17; x ^= x << 5; // xorshift32
+        sample[i] = x;
+    }
+
+    uint32_t counts[4][HIST_RADIX];
+    int best = 0;
+    uint64_t best_time = UINT64_MAX;
+    for (int k = 0; k < num_candidates; k++) {
+        candidates[k](sample, CALIBRATION_KEYS, counts); // warm up
+        uint64_t start = __rdtsc();
+        candidates[k](sample, CALIBRATION_KEYS, counts);
+        uint64_t time = __rdtsc() - start;
+        if (time < best_time) {
+            best_time = time;
+            best = k;
+        }
+    }
+    free(sample);
+    *name = names[best];
+    return candidates[best];
+}
+
+// fused kernel picked by histogram_all_select, set once by the first histogram_all_bytes
+#ifdef LIBSORT
+// defined once in libsort.c, so the engines of the library share one selection
+extern pthread_once_t histogram_all_once;
+extern histogram_all_fn histogram_all_kernel;
+extern const char *histogram_all_kernel_name;
+#else
+static pthread_once_t histogram_all_once = PTHREAD_ONCE_INIT;
+static histogram_all_fn histogram_all_kernel = NULL;
+static const char *histogram_all_kernel_name = NULL;
+#endif
+
+static inline void histogram_all_init(void) {
+    histogram_all_kernel = histogram_all_select(&histogram_all_kernel_name);
+}
+
+// name of the fused kernel ("scalar", "avx2" or "avx512")
+static inline const char *histogram_all_name(void) {
+    pthread_once(&histogram_all_once, histogram_all_init);
+    return histogram_all_kernel_name;
+}
+
+// histograms of all four bytes for any size, the kernel counts 2^31 keys at a
+// time and the chunks are added up in size_t counts
+static inline void histogram_all_bytes(const uint32_t *arr, size_t size, size_t (*counts)[HIST_RADIX]) {
+    uint32_t part[4][HIST_RADIX];
+    pthread_once(&histogram_all_once, histogram_all_init);
+    memset(counts, 0, 4 * sizeof(*counts));
+    for (size_t start = 0; start < size; start += (size_t)1 << 31) {
+        size_t count = (size - start > ((size_t)1 << 31)) ? (size_t)1 << 31 : size - start;
+        histogram_all_kernel(arr + start, count, part);
+        for (int digit = 0; digit < 4; digit++) {
+            for (int b = 0; b < HIST_RADIX; b++) {
+                counts[digit][b] += part[digit][b];
+            }
+        }
+    }
+}
+
+// a digit is trivial when every key lands in one bucket, its scatter pass
+// would copy the array without changing the order
+static inline int histogram_is_trivial(const uint32_t *counts, size_t size) {
+    for (int b = 0; b < HIST_RADIX; b++) {
+        if (counts[b] != 0) {
+            return counts[b] == size;
+        }
+    }
+    return 1;
+}
+
+static inline int histogram_is_trivial_wide(const size_t *counts, size_t size) {
+    for (int b = 0; b < HIST_RADIX; b++) {
+        if (counts[b] != 0) {
+            return counts[b] == size;
+        }
+    }
+    return 1;
+}
+
+#endif
@@ -0,0 +1,230 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <immintrin.h>
+#include <string.h>
+#include "sort_timing.h"
+#include "sort_data.h"
+#include "radix_histogram.h"
+#include "perf_counters.h"
+#include "libsort.h"
+
+/* Code for in-place MSD radix sort (American flag sort), one byte per level
+ * keys are permuted into their 256 buckets by swapping cycles inside the input
+ * array, so the only extra memory is the counts of each recursion level
+ * (O(radix * depth), depth <= 4 for uint32_t) instead of a second array
+ * small buckets finish with a cache sized LSD pass or insertion sort
+ * COMPILE: gcc -O3 -mavx2 -pthread -o radix_msd_inplace radix_msd_inplace.c
+ *          gcc -O3 -mavx2 -DSORT_PERF=1 -o radix_msd_perf radix_msd_inplace.c perf_counters.c
+ *          gcc -O3 -DLIBSORT -c radix_msd_inplace.c (engine only, see libsort.h)
+ * RUN: ./radix_msd_inplace [power]
+ * with a power argument only "power,size,cycles,ns,keys_per_s" is printed (data collection)
+ */
+
+#define RADIX 256
+#define MASK (RADIX - 1) // mask for 8 bits (0xFF)
+
+#define INSERTION_THRESHOLD 32 // buckets up to this size use insertion sort
+#define LSD_THRESHOLD 4096     // buckets up to this size (16KB) use an LSD pass on a stack buffer
+
+// Iterative sorting for small buckets (Insertion Sort)
+static void insertion_sort(uint32_t *arr, size_t size) {
+	for (size_t i = 1; i < size; i++) {
+		uint32_t key = arr[i];
+		size_t j = i;
+		while (j > 0 && arr[j - 1] > key) {
+			arr[j] = arr[j - 1];
+			j--;
+		}
+		arr[j] = key;
+	}
+}
+
+// LSD radix sort of a bucket that fits in cache on the bytes at shift and below
+// (the bytes above are equal inside one MSD bucket), the scratch array lives on the stack
+static void lsd_small(uint32_t *arr, size_t size, int shift) {
+	uint32_t scratch[LSD_THRESHOLD];
+	uint32_t counts[RADIX];
+	uint32_t *src = arr;
+	uint32_t *dst = scratch;
+
+	for (int s = 0; s <= shift; s += 8) {
+		memset(counts, 0, sizeof(counts));
+		for (size_t i = 0; i < size; i++) {
+			counts[(src[i] >> s) & MASK]++;
+		}
+		if (histogram_is_trivial(counts, size)) {
+			continue;
+		}
+
+		// convert counts from the histogram into placements
+		uint32_t placement = 0;
+		for (int b = 0; b < RADIX; b++) {
+			uint32_t count = counts[b];
+			counts[b] = placement;
+			placement += count;
+		}
+		for (size_t i = 0; i < size; i++) {
+			dst[counts[(src[i] >> s) & MASK]++] = src[i];
+		}
+
+		// rotate pointers from the sorting array to the sorted array
+		uint32_t *swap = src;
+		src = dst;
+		dst = swap;
+	}
+
+	if (src != arr) {
+		memcpy(arr, src, size * sizeof(uint32_t));
+	}
+}
+
+// sort arr on the byte at shift and recurse into every bucket on the byte below
+// the phases of the top level (depth 0) go to the phase counters (perf_counters.h)
+// counts are size_t, a bucket of an input near the size of memory can pass 2^32 keys
+static void msd_sort(uint32_t *arr, size_t size, int shift, int depth) {
+	size_t counts[RADIX];
+	size_t heads[RADIX]; // next unplaced slot of each bucket
+	size_t tails[RADIX]; // end of each bucket
+
+	PERF_PHASE_BEGIN_IF(depth == 0, histogram_start);
+	for (;;) {
+		if (size <= INSERTION_THRESHOLD) {
+			insertion_sort(arr, size);
+			return;
+		}
+		if (size <= LSD_THRESHOLD) {
+			lsd_small(arr, size, shift);
+			return;
+		}
+
+		histogram_wide(arr, size, shift, counts);
+
+		// every key has the same byte here, move straight on to the next byte
+		if (!histogram_is_trivial_wide(counts, size)) {
+			break;
+		}
+		if (shift == 0) {
+			return;
+		}
+		shift -= 8;
+	}
+	PERF_PHASE_END_IF(depth == 0, histogram_start, "radix_msd.histogram", shift / 8);
+
+	// convert counts from the histogram into bucket ranges
+	PERF_PHASE_BEGIN_IF(depth == 0, prefix_start);
+	size_t placement = 0;
+	for (int b = 0; b < RADIX; b++) {
+		heads[b] = placement;
+		placement += counts[b];
+		tails[b] = placement;
+	}
+	PERF_PHASE_END_IF(depth == 0, prefix_start, "radix_msd.prefix", shift / 8);
+
+	// american flag permutation: pick up the first misplaced key of a bucket and
+	// keep swapping it into the bucket it belongs to until the cycle comes back
+	PERF_PHASE_BEGIN_IF(depth == 0, permute_start);
+	for (int b = 0; b < RADIX; b++) {
+		while (heads[b] < tails[b]) {
+			uint32_t value = arr[heads[b]];
+			int digit = (value >> shift) & MASK;
+			while (digit != b) {
+				uint32_t swap = arr[heads[digit]];
+				arr[heads[digit]++] = value;
+				value = swap;
+				digit = (value >> shift) & MASK;
+			}
+			arr[heads[b]++] = value;
+		}
+	}
+	PERF_PHASE_END_IF(depth == 0, permute_start, "radix_msd.permute", shift / 8);
+
+	// the lowest byte has no further digits to sort on
+	if (shift == 0) {
+		return;
+	}
+
+	PERF_PHASE_BEGIN_IF(depth == 0, recursion_start);
+	size_t start = 0;
+	for (int b = 0; b < RADIX; b++) {
+		if (counts[b] > 1) {
+			msd_sort(arr + start, counts[b], shift - 8, depth + 1);
+		}
+		start += counts[b];
+	}
+	PERF_PHASE_END_IF(depth == 0, recursion_start, "radix_msd.buckets", shift / 8 - 1);
+}
+
+// in-place MSD radix sort
+void radix_msd_inplace(uint32_t *arr, size_t size) {
+	// start at the most significant byte
+	msd_sort(arr, size, 24, 0);
+}
+
+#ifndef LIBSORT
+// Avoid making changes to this function skeleton, apart from data type changes if required
+// In this starter code we have used uint32_t, feel free to change it to any other data type if required
+void sort_array(uint32_t *arr, size_t size) {
+	radix_msd_inplace(arr, size);
+}
+
+// main
+int main(int argc, char *argv[]) {
+
+	// FOR DATA COLLECTION pass the power of two of the array size
+	int collect = (argc == 2);
+	int power = collect ? atoi(argv[1]) : 30;
+	size_t size = (size_t)1 << power; // default 2^30 elements (4GB given elements are unit32_t, no second array)
+
+	uint32_t *arr = malloc(size * sizeof(uint32_t));
+	if (!arr) {
+		perror("Failed to allocate memory");
+		exit(EXIT_FAILURE);
+	}
+
+	// fill the array with random numbers
+	data_fill_u32(arr, size, data_spec_of(DATA_UNIFORM), (uint64_t)time(NULL), 0);
+	data_checksum checksum = data_checksum_u32(arr, size, 0);
+
+	// declare variables for timing
+	uint64_t start, end, time;
+
+	// in-place radix sorting and timing
+#if SORT_PERF
+	perf_open();
+#endif
+	start = rdtsc_start();
+	sort_array(arr, size);
+	end = rdtsc_stop();
+	time = end - start;
+#if SORT_PERF
+	// phase breakdown on stderr, stdout keeps its format
+	perf_print(stderr);
+	perf_close();
+#endif
+
+	if (collect) {
+		printf("%d,%zu,%lu,%.0f,%.0f\n", power, size, time, timing_ns(time), timing_keys_per_s(time, size));
+	} else {
+		printf("In-place MSD sort time: " TIMING_FMT "\n", TIMING_ARGS(time, size));
+	}
+
+	// validate sorting
+	if (!data_verify_u32(arr, size, checksum, 0)) {
+		printf("In-place MSD sorting failed.\n");
+		// cleanup on failure
+		free(arr);
+		return 1;
+	}
+
+	if (!collect) {
+		printf("done and validated\n");
+	}
+
+	// cleanup
+	free(arr);
+
+	return 0;
+}
+#endif
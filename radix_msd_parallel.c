@@ -0,0 +1,487 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <immintrin.h>
+#include <string.h>
+#include <unistd.h>
+#include "sort_timing.h"
+#include "sort_data.h"
+#include "radix_histogram.h"
+#include "thread_pool.h"
+#include "libsort.h"
+
+/* Code for parallel in-place MSD radix sort (American flag sort) on a work-stealing pool
+ * a bucket task histograms its byte, permutes its keys into 256 sub-buckets in place
+ * and pushes every large sub-bucket as a new task, so large buckets keep splitting
+ * and idle threads steal whatever is left instead of owning a fixed range
+ * buckets that cover a large part of the input also split their histogram pass
+ * across the pool, bytes shared by every key of a bucket are skipped without
+ * touching the keys (keys of 0..99 need one real pass)
+ * their permutation is split across the pool as well (PARADIS): every thread
+ * gets a stripe of each bucket's open range and swaps the keys of its stripes
+ * into place, a key whose own stripe is full is parked at the end of the stripe
+ * it came from, a repair pass moves the parked keys behind the keys that
+ * arrived in each bucket and the next round permutes what is still open, the
+ * last few keys go through the serial permutation, so a dominant bucket (or
+ * the only byte that differs) is permuted on every thread, not one
+ * extra memory stays O(radix * depth) per thread plus the task records and
+ * the stripes of a parallel permutation
+ * COMPILE: gcc -O3 -mavx2 -pthread -o radix_msd_parallel radix_msd_parallel.c
+ *          gcc -O3 -pthread -DLIBSORT -c radix_msd_parallel.c (engine only, see libsort.h)
+ * RUN: ./radix_msd_parallel [power] [threads]
+ * with arguments only "power,size,cycles,ns,keys_per_s" is printed (data collection)
+ */
+
+#define RADIX 256
+#define MASK (RADIX - 1) // mask for 8 bits (0xFF)
+
+#define INSERTION_THRESHOLD 32   // buckets up to this size use insertion sort
+#define LSD_THRESHOLD 4096       // buckets up to this size (16KB) use an LSD pass on a stack buffer
+#define TASK_THRESHOLD (1 << 16) // buckets larger than this become tasks of their own
+#define HIST_CHUNK (1 << 16)     // smallest chunk of a parallel histogram
+#define MAX_HIST_CHUNKS 64
+#define PERMUTE_ROUNDS 4         // parallel permutation rounds before the serial finish
+
+// one bucket still to be sorted
+typedef struct {
+    thread_pool *pool;
+    task_group *group; // every bucket task of one sort
+    uint32_t *arr;
+    size_t size;
+    int shift;
+} MsdTask;
+
+// the stripes of one thread in a parallel permutation, keys [lo, head) of a
+// stripe are in their bucket, [tail, hi) parked, [head, tail) not seen yet
+typedef struct {
+    uint32_t *arr;
+    int shift;
+    size_t lo[RADIX], head[RADIX], tail[RADIX], hi[RADIX];
+} PermuteTask;
+
+// one chunk of a parallel histogram
+typedef struct {
+    const uint32_t *arr;
+    size_t size;
+    int shift;
+    size_t *counts;
+} CountTask;
+
+// Iterative sorting for small buckets (Insertion Sort)
+static void insertion_sort(uint32_t *arr, size_t size) {
+    for (size_t i = 1; i < size; i++) {
+        uint32_t key = arr[i];
+        size_t j = i;
+        while (j > 0 && arr[j - 1] > key) {
+            arr[j] = arr[j - 1];
+            j--;
+        }
+        arr[j] = key;
+    }
+}
+
+// LSD radix sort of a bucket that fits in cache on the bytes at shift and below
+static void lsd_small(uint32_t *arr, size_t size, int shift) {
+    uint32_t scratch[LSD_THRESHOLD];
+    uint32_t counts[RADIX];
+    uint32_t *src = arr;
+    uint32_t *dst = scratch;
+
+    for (int s = 0; s <= shift; s += 8) {
+        memset(counts, 0, sizeof(counts));
+        for (size_t i = 0; i < size; i++) {
+            counts[(src[i] >> s) & MASK]++;
+        }
+        if (histogram_is_trivial(counts, size)) {
+            continue;
+        }
+
+        uint32_t placement = 0;
+        for (int b = 0; b < RADIX; b++) {
+            uint32_t count = counts[b];
+            counts[b] = placement;
+            placement += count;
+        }
+        for (size_t i = 0; i < size; i++) {
+            dst[counts[(src[i] >> s) & MASK]++] = src[i];
+        }
+
+        uint32_t *swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    if (src != arr) {
+        memcpy(arr, src, size * sizeof(uint32_t));
+    }
+}
+
+// swap the keys of the open ranges [heads[b], tails[b]) into their buckets on
+// the byte at shift, the open ranges hold exactly the keys they are missing
+static void flag_permute_ranges(uint32_t *arr, size_t *heads, const size_t *tails, int shift) {
+    for (int b = 0; b < RADIX; b++) {
+        while (heads[b] < tails[b]) {
+            uint32_t value = arr[heads[b]];
+            int digit = (value >> shift) & MASK;
+            while (digit != b) {
+                uint32_t swap = arr[heads[digit]];
+                arr[heads[digit]++] = value;
+                value = swap;
+                digit = (value >> shift) & MASK;
+            }
+            arr[heads[b]++] = value;
+        }
+    }
+}
+
+// swap every key of arr into its bucket on the byte at shift
+static void flag_permute(uint32_t *arr, const size_t *counts, int shift) {
+    size_t heads[RADIX]; // next unplaced slot of each bucket
+    size_t tails[RADIX]; // end of each bucket
+
+    size_t placement = 0;
+    for (int b = 0; b < RADIX; b++) {
+        heads[b] = placement;
+        placement += counts[b];
+        tails[b] = placement;
+    }
+    flag_permute_ranges(arr, heads, tails, shift);
+}
+
+// serial in-place MSD sort of one bucket
+// counts are size_t, a bucket of few distinct keys can pass 2^32 keys
+static void msd_sort(uint32_t *arr, size_t size, int shift) {
+    size_t counts[RADIX];
+
+    for (;;) {
+        if (size <= INSERTION_THRESHOLD) {
+            insertion_sort(arr, size);
+            return;
+        }
+        if (size <= LSD_THRESHOLD) {
+            lsd_small(arr, size, shift);
+            return;
+        }
+        histogram_wide(arr, size, shift, counts);
+        if (!histogram_is_trivial_wide(counts, size)) {
+            break;
+        }
+        if (shift == 0) {
+            return;
+        }
+        shift -= 8;
+    }
+
+    flag_permute(arr, counts, shift);
+    if (shift == 0) {
+        return;
+    }
+
+    size_t start = 0;
+    for (int b = 0; b < RADIX; b++) {
+        if (counts[b] > 1) {
+            msd_sort(arr + start, counts[b], shift - 8);
+        }
+        start += counts[b];
+    }
+}
+
+static void count_task(void *arg) {
+    CountTask *task = (CountTask *)arg;
+    histogram_wide(task->arr, task->size, task->shift, task->counts);
+}
+
+// histogram of a large bucket split across the pool
+static void parallel_histogram(thread_pool *pool, const uint32_t *arr, size_t size, int shift, size_t *counts) {
+    size_t chunks = pool->num_workers + 1;
+    if (chunks > MAX_HIST_CHUNKS) {
+        chunks = MAX_HIST_CHUNKS;
+    }
+    if (chunks > size / HIST_CHUNK) {
+        chunks = size / HIST_CHUNK;
+    }
+    if (chunks <= 1) {
+        histogram_wide(arr, size, shift, counts);
+        return;
+    }
+
+    CountTask tasks[MAX_HIST_CHUNKS];
+    size_t chunk_counts[MAX_HIST_CHUNKS][RADIX];
+    task_group group;
+    task_group_init(&group);
+
+    for (size_t c = 0; c < chunks; c++) {
+        size_t lo = size * c / chunks;
+        size_t hi = size * (c + 1) / chunks;
+        tasks[c].arr = arr + lo;
+        tasks[c].size = hi - lo;
+        tasks[c].shift = shift;
+        tasks[c].counts = chunk_counts[c];
+        if (c > 0) {
+            pool_submit(pool, &group, count_task, &tasks[c]);
+        }
+    }
+    // count the first chunk here, then help with the rest
+    count_task(&tasks[0]);
+    pool_wait(pool, &group);
+
+    for (int b = 0; b < RADIX; b++) {
+        size_t total = 0;
+        for (size_t c = 0; c < chunks; c++) {
+            total += chunk_counts[c][b];
+        }
+        counts[b] = total;
+    }
+}
+
+// the cycles of flag_permute inside the stripes of one thread, a key whose
+// stripe is full trades places with the last unseen key of the stripe it is in
+static void permute_task(void *arg) {
+    PermuteTask *task = (PermuteTask *)arg;
+    uint32_t *arr = task->arr;
+    size_t *head = task->head;
+    size_t *tail = task->tail;
+    int shift = task->shift;
+
+    for (int b = 0; b < RADIX; b++) {
+        while (head[b] < tail[b]) {
+            uint32_t value = arr[head[b]];
+            int digit = (value >> shift) & MASK;
+            while (digit != b && head[digit] < tail[digit]) {
+                uint32_t swap = arr[head[digit]];
+                arr[head[digit]++] = value;
+                value = swap;
+                digit = (value >> shift) & MASK;
+            }
+            if (digit == b) {
+                arr[head[b]++] = value;
+            } else {
+                tail[b]--;
+                arr[head[b]] = arr[tail[b]];
+                arr[tail[b]] = value;
+            }
+        }
+    }
+}
+
+// the keys that arrived in bucket b to its front and the parked ones behind
+// them, swapped pairwise, returns the new start of the bucket's open range
+static size_t permute_repair(uint32_t *arr, PermuteTask *tasks, size_t stripes, int b, size_t start) {
+    size_t boundary = start;
+    for (size_t t = 0; t < stripes; t++) {
+        boundary += tasks[t].head[b] - tasks[t].lo[b];
+    }
+
+    // parked keys below the boundary meet placed keys above it, one for one
+    size_t placed = 0;
+    size_t next = tasks[0].lo[b] > boundary ? tasks[0].lo[b] : boundary;
+    for (size_t t = 0; t < stripes; t++) {
+        for (size_t i = tasks[t].tail[b]; i < tasks[t].hi[b] && i < boundary; i++) {
+            while (next >= tasks[placed].head[b]) {
+                placed++;
+                next = tasks[placed].lo[b] > boundary ? tasks[placed].lo[b] : boundary;
+            }
+            uint32_t swap = arr[i];
+            arr[i] = arr[next];
+            arr[next++] = swap;
+        }
+    }
+    return boundary;
+}
+
+// flag_permute with the open ranges split into stripes across the pool
+static void parallel_permute(thread_pool *pool, uint32_t *arr, const size_t *counts, int shift) {
+    size_t heads[RADIX];
+    size_t tails[RADIX];
+    size_t placement = 0;
+    for (int b = 0; b < RADIX; b++) {
+        heads[b] = placement;
+        placement += counts[b];
+        tails[b] = placement;
+    }
+
+    PermuteTask *tasks = NULL;
+    for (int round = 0; round < PERMUTE_ROUNDS; round++) {
+        size_t open = 0;
+        for (int b = 0; b < RADIX; b++) {
+            open += tails[b] - heads[b];
+        }
+        size_t stripes = pool->num_workers + 1;
+        if (stripes > MAX_HIST_CHUNKS) {
+            stripes = MAX_HIST_CHUNKS;
+        }
+        if (stripes > open / HIST_CHUNK) {
+            stripes = open / HIST_CHUNK;
+        }
+        if (stripes <= 1) {
+            break;
+        }
+        if (!tasks) {
+            tasks = malloc(MAX_HIST_CHUNKS * sizeof(PermuteTask));
+            if (!tasks) {
+                // permute it on this thread
+                break;
+            }
+        }
+
+        task_group group;
+        task_group_init(&group);
+        for (size_t t = 0; t < stripes; t++) {
+            tasks[t].arr = arr;
+            tasks[t].shift = shift;
+            for (int b = 0; b < RADIX; b++) {
+                size_t length = tails[b] - heads[b];
+                tasks[t].lo[b] = tasks[t].head[b] = heads[b] + length * t / stripes;
+                tasks[t].tail[b] = tasks[t].hi[b] = heads[b] + length * (t + 1) / stripes;
+            }
+            if (t > 0) {
+                pool_submit(pool, &group, permute_task, &tasks[t]);
+            }
+        }
+        permute_task(&tasks[0]);
+        pool_wait(pool, &group);
+
+        for (int b = 0; b < RADIX; b++) {
+            heads[b] = permute_repair(arr, tasks, stripes, b, heads[b]);
+        }
+    }
+    free(tasks);
+
+    // what is left is small, or keeps missing its stripes
+    flag_permute_ranges(arr, heads, tails, shift);
+}
+
+static void msd_task_run(void *arg);
+
+static void submit_bucket(thread_pool *pool, task_group *group, uint32_t *arr, size_t size, int shift) {
+    MsdTask *task = malloc(sizeof(MsdTask));
+    if (!task) {
+        perror("Failed to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+    task->pool = pool;
+    task->group = group;
+    task->arr = arr;
+    task->size = size;
+    task->shift = shift;
+    pool_submit(pool, group, msd_task_run, task);
+}
+
+// sort one large bucket: partition it in place and hand its large sub-buckets to the pool
+static void msd_parallel(thread_pool *pool, task_group *group, uint32_t *arr, size_t size, int shift) {
+    size_t counts[RADIX];
+
+    if (size <= TASK_THRESHOLD) {
+        msd_sort(arr, size, shift);
+        return;
+    }
+
+    for (;;) {
+        parallel_histogram(pool, arr, size, shift, counts);
+        if (!histogram_is_trivial_wide(counts, size)) {
+            break;
+        }
+        if (shift == 0) {
+            return;
+        }
+        shift -= 8;
+    }
+
+    parallel_permute(pool, arr, counts, shift);
+    if (shift == 0) {
+        return;
+    }
+
+    // publish the large sub-buckets first so other threads can steal them ...
+    size_t start = 0;
+    for (int b = 0; b < RADIX; b++) {
+        if (counts[b] > TASK_THRESHOLD) {
+            submit_bucket(pool, group, arr + start, counts[b], shift - 8);
+        }
+        start += counts[b];
+    }
+
+    // ... then sort the small ones on this thread
+    start = 0;
+    for (int b = 0; b < RADIX; b++) {
+        if (counts[b] > 1 && counts[b] <= TASK_THRESHOLD) {
+            msd_sort(arr + start, counts[b], shift - 8);
+        }
+        start += counts[b];
+    }
+}
+
+static void msd_task_run(void *arg) {
+    MsdTask *task = (MsdTask *)arg;
+    msd_parallel(task->pool, task->group, task->arr, task->size, task->shift);
+    free(task);
+}
+
+// parallel in-place radix sort on an existing pool
+void radix_msd_parallel_pool(thread_pool *pool, uint32_t *arr, size_t size) {
+    task_group group;
+    task_group_init(&group);
+    msd_parallel(pool, &group, arr, size, 24);
+    pool_wait(pool, &group);
+}
+
+// parallel in-place radix sort with an explicit thread count
+void radix_msd_parallel(uint32_t *arr, size_t size, int num_threads) {
+    // the calling thread helps, so start one worker less
+    thread_pool *pool = pool_create(num_threads - 1);
+    radix_msd_parallel_pool(pool, arr, size);
+    pool_destroy(pool);
+}
+
+#ifndef LIBSORT
+// Avoid making changes to this function skeleton, apart from data type changes if required
+// In this starter code we have used uint32_t, feel free to change it to any other data type if required
+void sort_array(uint32_t *arr, size_t size) {
+    // use every online core
+    radix_msd_parallel(arr, size, (int)sysconf(_SC_NPROCESSORS_ONLN));
+}
+
+int main(int argc, char *argv[]) {
+    // FOR DATA COLLECTION pass the power of two of the array size (and a thread count)
+    int collect = (argc >= 2);
+    int power = collect ? atoi(argv[1]) : 30;
+    int num_threads = (argc > 2) ? atoi(argv[2]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    size_t size = (size_t)1 << power; // default 2^30 elements (4GB given elements are unit32_t, no second array)
+
+    uint32_t *arr = malloc(size * sizeof(uint32_t));
+    if (!arr) {
+        perror("Failed to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+
+    data_fill_u32(arr, size, data_spec_of(DATA_UNIFORM), (uint64_t)time(NULL), 0);
+    data_checksum checksum = data_checksum_u32(arr, size, 0);
+
+    uint64_t start, end, time;
+    start = rdtsc_start();
+    radix_msd_parallel(arr, size, num_threads);
+    end = rdtsc_stop();
+    time = end - start;
+
+    if (collect) {
+        printf("%d,%zu,%lu,%.0f,%.0f\n", power, size, time, timing_ns(time), timing_keys_per_s(time, size));
+    } else {
+        printf("Parallel in-place MSD sort time (%d threads): " TIMING_FMT "\n", num_threads, TIMING_ARGS(time, size));
+    }
+
+    // validate sorting
+    if (!data_verify_u32(arr, size, checksum, 0)) {
+        printf("Parallel in-place MSD sorting failed.\n");
+        free(arr);
+        return 1;
+    }
+
+    if (!collect) {
+        printf("done and validated\n");
+    }
+
+    free(arr);
+    return 0;
+}
+#endif
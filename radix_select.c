@@ -0,0 +1,244 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <string.h>
+#include "sort_timing.h"
+#include "sort_data.h"
+#include "radix_histogram.h"
+#include "libsort.h"
+
+/* Top-K / partial sort by radix selection
+ * the byte histogram of the top digit tells which bucket holds the key of rank
+ * k, a branch free partition moves the buckets up to it to the front, a second
+ * one splits those into the smaller buckets and the bucket itself, and only the
+ * keys of that bucket go on to the next byte, so for spread keys the whole
+ * selection is a histogram read, one partition pass, a pass over the front part
+ * and a tail of size / 256 keys, the first k keys are sorted afterwards only
+ * when asked for
+ * the histograms use the kernels of radix_histogram.h, the sort of the first k
+ * keys is an LSD radix on them alone
+ * COMPILE: gcc -O3 -pthread -o radix_select radix_select.c
+ *          gcc -O3 -DLIBSORT -c radix_select.c (engine only, see libsort.h)
+ * RUN: ./radix_select [power] [k]
+ * k defaults to size / 100, with arguments only "power,size,k,cycles,ns,keys_per_s"
+ * is printed (data collection), the times are those of the sorted top-k
+ */
+
+#define SELECT_SMALL 32 // regions this small finish with an insertion sort
+
+static void insertion_sort(uint32_t *arr, size_t size) {
+    for (size_t i = 1; i < size; i++) {
+        uint32_t key = arr[i];
+        size_t j = i;
+        while (j > 0 && arr[j - 1] > key) {
+            arr[j] = arr[j - 1];
+            j--;
+        }
+        arr[j] = key;
+    }
+}
+
+// LSD radix sort of arr[0..size), skipping the bytes every key shares
+static void sort_head(uint32_t *arr, size_t size) {
+    if (size <= SELECT_SMALL) {
+        insertion_sort(arr, size);
+        return;
+    }
+
+    uint32_t *scratch = malloc(size * sizeof(uint32_t));
+    if (!scratch) {
+        perror("Failed to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+
+    uint32_t *src = arr;
+    uint32_t *dst = scratch;
+    size_t counts[HIST_RADIX];
+    size_t placements[HIST_RADIX];
+
+    for (int shift = 0; shift < 32; shift += 8) {
+        histogram_wide(src, size, shift, counts);
+        size_t placement = 0;
+        int trivial = 0;
+        for (int b = 0; b < HIST_RADIX; b++) {
+            trivial |= counts[b] == size;
+            placements[b] = placement;
+            placement += counts[b];
+        }
+        if (trivial) {
+            continue;
+        }
+
+        for (size_t i = 0; i < size; i++) {
+            dst[placements[(src[i] >> shift) & HIST_MASK]++] = src[i];
+        }
+        uint32_t *swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    if (src != arr) {
+        memcpy(arr, src, size * sizeof(uint32_t));
+    }
+    free(scratch);
+}
+
+// moves the keys of arr[lo..hi) whose byte at shift is below limit to the
+// front, returns where they end, the swap runs on every key so the loop has no
+// data dependent branch (the digits of a random region would mispredict half
+// of the time)
+static size_t partition_below(uint32_t *arr, size_t lo, size_t hi, int shift, int limit) {
+    size_t lt = lo;
+    for (size_t i = lo; i < hi; i++) {
+        uint32_t key = arr[i];
+        arr[i] = arr[lt];
+        arr[lt] = key;
+        lt += (int)((key >> shift) & HIST_MASK) < limit;
+    }
+    return lt;
+}
+
+// moves the key of rank n (0 based) to arr[n], the smaller keys before it and
+// the larger ones after it (like nth_element), returns the key, n < size
+uint32_t radix_select(uint32_t *arr, size_t size, size_t n) {
+    size_t lo = 0;
+    size_t hi = size;
+    size_t counts[HIST_RADIX];
+
+    histogram_wide(arr, size, 24, counts);
+
+    for (int shift = 24; shift >= 0 && hi - lo > SELECT_SMALL; shift -= 8) {
+        // bucket holding rank n and the number of keys in the buckets below it
+        size_t below = 0;
+        int bucket = 0;
+        while (below + counts[bucket] <= n - lo) {
+            below += counts[bucket++];
+        }
+
+        if (counts[bucket] == hi - lo) {
+            // every key of the region shares this byte, nothing moves
+            if (shift > 0) {
+                histogram_wide(arr + lo, hi - lo, shift - 8, counts);
+            }
+            continue;
+        }
+
+        // [lo, lt) below the bucket, [lt, le) in it, the rest above, the keys
+        // up to the bucket are split off first, then split again on their own
+        size_t le = partition_below(arr, lo, hi, shift, bucket + 1);
+        size_t lt = partition_below(arr, lo, le, shift, bucket);
+        if (shift > 0) {
+            histogram_wide(arr + lt, le - lt, shift - 8, counts);
+        }
+
+        lo = lt;
+        hi = le;
+    }
+
+    // a small region is sorted outright, otherwise every key left is equal
+    if (hi - lo <= SELECT_SMALL) {
+        insertion_sort(arr + lo, hi - lo);
+    }
+    return arr[n];
+}
+
+// moves the k smallest keys to arr[0..k), sorted ascending when sorted is set,
+// the rest follows in no particular order
+// the k largest keys are arr[size - k..) after radix_select_k(arr, size, size - k, 0)
+void radix_select_k(uint32_t *arr, size_t size, size_t k, int sorted) {
+    if (k == 0 || size < 2) {
+        return;
+    }
+    if (k < size) {
+        radix_select(arr, size, k);
+    }
+    if (sorted) {
+        sort_head(arr, k < size ? k : size);
+    }
+}
+
+// the k smallest keys sorted at the front of arr
+void radix_partial_sort(uint32_t *arr, size_t size, size_t k) {
+    radix_select_k(arr, size, k, 1);
+}
+
+#ifndef LIBSORT
+int main(int argc, char *argv[]) {
+    // FOR DATA COLLECTION pass the power of two of the array size (and k)
+    int collect = (argc >= 2);
+    int power = collect ? atoi(argv[1]) : 26;
+    size_t size = (size_t)1 << power;
+    size_t k = (argc > 2) ? (size_t)atol(argv[2]) : size / 100;
+    if (k > size) {
+        k = size;
+    }
+
+    uint32_t *arr = malloc(size * sizeof(uint32_t));
+    uint32_t *copy = malloc(size * sizeof(uint32_t));
+    if (!arr || !copy) {
+        perror("Failed to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+
+    data_fill_u32(arr, size, data_spec_of(DATA_UNIFORM), (uint64_t)time(NULL), 0);
+    memcpy(copy, arr, size * sizeof(uint32_t));
+    data_checksum checksum = data_checksum_u32(arr, size, 0);
+
+    uint64_t start, end, top_time, median_time;
+
+    start = rdtsc_start();
+    radix_partial_sort(arr, size, k);
+    end = rdtsc_stop();
+    top_time = end - start;
+
+    // the first k keys are sorted and none of the rest is smaller, no key is lost
+    if (!data_checksum_equal(data_checksum_u32(arr, size, 0), checksum)) {
+        printf("Partial sorting failed.\n");
+        return 1;
+    }
+    uint32_t largest = 0;
+    for (size_t i = 0; i < k; i++) {
+        if (i > 0 && arr[i - 1] > arr[i]) {
+            printf("Partial sorting failed.\n");
+            return 1;
+        }
+        largest = arr[i];
+    }
+    for (size_t i = k; i < size; i++) {
+        if (k > 0 && arr[i] < largest) {
+            printf("Top-k selection failed.\n");
+            return 1;
+        }
+    }
+
+    start = rdtsc_start();
+    uint32_t median = radix_select(copy, size, size / 2);
+    end = rdtsc_stop();
+    median_time = end - start;
+
+    if (!data_checksum_equal(data_checksum_u32(copy, size, 0), checksum)) {
+        printf("Median selection failed.\n");
+        return 1;
+    }
+    for (size_t i = 0; i < size; i++) {
+        if ((i < size / 2 && copy[i] > median) || (i > size / 2 && copy[i] < median)) {
+            printf("Median selection failed.\n");
+            return 1;
+        }
+    }
+
+    if (collect) {
+        printf("%d,%zu,%zu,%lu,%.0f,%.0f\n", power, size, k, top_time, timing_ns(top_time),
+               timing_keys_per_s(top_time, size));
+    } else {
+        printf("Sorted top %zu time: " TIMING_FMT "\n", k, TIMING_ARGS(top_time, size));
+        printf("Median selection time: " TIMING_FMT "\n", TIMING_ARGS(median_time, size));
+        printf("done and validated\n");
+    }
+
+    free(copy);
+    free(arr);
+    return 0;
+}
+#endif
@@ -4,18 +4,21 @@
 #include <time.h>
 #include <immintrin.h>
 #include <string.h>
+#include "sort_timing.h"
+#include "sort_data.h"
+#include "radix_histogram.h"
 
 /* Code for SIMD vectorization of radix sort using intel AVX2 intrinsics
- * COMPILE: gcc -O3 -mavx2 -o radix_sort_simd radix_simd_vs_vanilla.c
+ * COMPILE: gcc -O3 -mavx2 -pthread -o radix_sort_simd radix_simd_vs_vanilla.c
  * RUN: ./radix_sort_simd
  */
 
-// function for timing cpu cycles
-static inline uint64_t rdtsc() {
-	unsigned long a, d;
-	asm volatile("rdtsc" : "=a"(a), "=d"(d));
-	return a | ((uint64_t)d << 32);
-}
+// FUSED_HISTOGRAM 1: count all 4 bytes in a single read before the first scatter
+// and skip passes whose byte is the same for every key
+// FUSED_HISTOGRAM 0: rebuild the histogram at the top of every pass
+#ifndef FUSED_HISTOGRAM
+#define FUSED_HISTOGRAM 1
+#endif
 
 // SIMD accelerated radix sort
 void sort_array(uint32_t *arr, size_t size) {
@@ -35,26 +38,36 @@ void sort_array(uint32_t *arr, size_t size) {
 	uint32_t counts[RADIX] __attribute__((aligned(32)));
 	uint32_t placements[RADIX] __attribute__((aligned(32)));
 
+	// remember the caller's array, skipped passes can leave the result in the scratch array
+	uint32_t *input = arr;
+	uint32_t *scratch = sorting_arr;
+
+#if FUSED_HISTOGRAM
+	// one read of the input gives the histograms of all 4 bytes
+	size_t all_counts[4][RADIX] __attribute__((aligned(32)));
+	histogram_all_bytes(arr, size, all_counts);
+#endif
+
 	// main sorting loop
 	// sort by each byte from least to most significant (4 digits bc 4 bytes in unint32_t)
     for (int digit = 0; digit < 4; digit++) {
 		
-		memset(counts, 0, sizeof(counts)); // zero out the histogram for curr byte
         __m256i mask = _mm256_set1_epi32(MASK); // mask to extract one byte
         __m256i shift = _mm256_set1_epi32(digit * 8); // shift amount for curr byte	
 
-		// count the instances of each number at the current byte
-        for (size_t i = 0; i < size; i += 8) {
-            // parallelized simd extraction of byte values 8 integers at a time 
-            __m256i elements = _mm256_loadu_si256((__m256i *)&arr[i]); // load 8 ints
-            __m256i shifted = _mm256_srlv_epi32(elements, shift); // bit shift to target byte
-            __m256i byte = _mm256_and_si256(shifted, mask); // extract  byte
-                    
-            // serial incrementation of the histogram
-            for (int j = 0; j < 8; j++) {
-                counts[_mm256_extract_epi32(byte, j)]++;
-            }
+#if FUSED_HISTOGRAM
+        // every key has the same byte here, so this pass would only copy the array
+        if (histogram_is_trivial_wide(all_counts[digit], size)) {
+            continue;
+        }
+        for (int b = 0; b < RADIX; b++) {
+            counts[b] = (uint32_t)all_counts[digit][b];
         }
+#else
+		// count the instances of each number at the current byte
+        // (vectorized sub-histogram kernel picked by CPUID, see radix_histogram.h)
+        histogram_byte(arr, size, digit * 8, counts);
+#endif
 
         // convert counts from the histogram into placements
         placements[0] = 0;
@@ -83,8 +96,13 @@ void sort_array(uint32_t *arr, size_t size) {
         sorting_arr = swap;
     }
 	
+	// an odd number of passes leaves the result in the scratch array
+	if (arr != input) {
+		memcpy(input, arr, size * sizeof(uint32_t));
+	}
+
 	// cleanup sorting array 
-    free(sorting_arr); 
+	free(scratch); 
 
 }
 
@@ -168,30 +186,28 @@ int main(int argc, char *argv[]) {
 	}
 
 	// fill the arrays with (the same) random numbers
-    srand((unsigned)time(NULL));
-	for (size_t i = 0; i < size; i++) {
-		arr_simd[i] = rand();
-		arr_vnla[i] = arr_simd[i];
-    }
+    data_fill_u32(arr_simd, size, data_spec_of(DATA_UNIFORM), (uint64_t)time(NULL), 0);
+    memcpy(arr_vnla, arr_simd, size * sizeof(uint32_t));
+    data_checksum checksum = data_checksum_u32(arr_simd, size, 0);
 
     // declare variables for timing
     uint64_t start, end, simd_time, vanilla_time;
 
     // SIMD radix sorting and timing
-    start = rdtsc();
+    start = rdtsc_start();
     sort_array(arr_simd, size);
-    end = rdtsc();
+    end = rdtsc_stop();
     simd_time = end - start;
 
     // vanilla radix sorting and timing
-    start = rdtsc();
+    start = rdtsc_start();
     radix_sort_vanilla(arr_vnla, size);
-    end = rdtsc();
+    end = rdtsc_stop();
     vanilla_time = end - start;
 
     // compare sorting results in cycles and speedup
-    printf("SIMD sort time: %lu cycles\n", simd_time);
-    printf("Vanilla sort time: %lu cycles\n", vanilla_time);
+    printf("SIMD sort time: " TIMING_FMT "\n", TIMING_ARGS(simd_time, size));
+    printf("Vanilla sort time: " TIMING_FMT "\n", TIMING_ARGS(vanilla_time, size));
     printf("Speedup: %.2f%%\n", ((double)(vanilla_time - simd_time) / simd_time) * 100);
 
     // print results for csv
@@ -199,20 +215,17 @@ int main(int argc, char *argv[]) {
     //printf("%d,%zu,%lu,%lu,%.2f\n", power, size, simd_time, vanilla_time, speedup);
 
     // validate sorting 
-    for (size_t i = 1; i < size; i++) {
-        if (arr_simd[i - 1] > arr_simd[i] || arr_vnla[i - 1] > arr_vnla[i]) {
-            if (arr_simd[i - 1] > arr_simd[i]) {
-                printf("Simd sorting failed.\n");
-            } else {
-                printf("Vanilla sorting failed.\n");
-            }
-            // cleanup on failure
-            free(arr_simd);
-            free(arr_vnla);
-            return 1;
+    int simd_ok = data_verify_u32(arr_simd, size, checksum, 0);
+    if (!simd_ok || !data_verify_u32(arr_vnla, size, checksum, 0)) {
+        if (!simd_ok) {
+            printf("Simd sorting failed.\n");
+        } else {
+            printf("Vanilla sorting failed.\n");
         }
-        // printf("%d\n", arr_simd[i]);
-        // printf("%d\n", arr_vnla[i]);
+        // cleanup on failure
+        free(arr_simd);
+        free(arr_vnla);
+        return 1;
     }
 
     // cleanup
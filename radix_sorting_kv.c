@@ -0,0 +1,553 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <string.h>
+#include "sort_timing.h"
+#include "sort_data.h"
+#include "sort_alloc.h"
+#include "radix_histogram.h"
+#include "libsort.h"
+
+/* LSD radix sort for 64 bit keys and for keys with a payload (struct of arrays)
+ * the same pass structure as radix_sorting_simd.c: one read builds the
+ * histograms of every digit, digits every key shares are skipped, and each
+ * remaining pass scatters the key and its payload in the same loop, so records
+ * never have to be packed into one wide key and unpacked again
+ * 64 bit keys use RADIX_KV_BITS bit digits (default 11: 6 passes instead of 8,
+ * the 2048 placements of a scatter pass, 16 KB, still fit in L1, the fused
+ * histogram of the 6 digits is 48 KB of uint32_t counts and sits in L2, which
+ * costs far less than the 2 extra passes over keys and payloads), 32 bit keys
+ * use 8 bit digits and the fused byte histogram of radix_sorting_simd.c
+ * (histogram_all_bytes in radix_histogram.h)
+ * the sort is stable, equal keys keep the order of their payloads
+ * signed and floating point keys are sorted as the unsigned integers their bits
+ * map to under an order preserving transform (signed: flip the sign bit, float:
+ * flip every bit of negative values and the sign bit of the rest), the transform
+ * runs in the histogram read and the first scatter, its inverse in the last
+ * scatter, so they add no memory pass
+ * floats order as -NaN < -inf < ... < -0.0 < +0.0 < ... < +inf < +NaN
+ * argsort (radix_argsort_*) runs the same passes with uint32_t indices as the
+ * payload, the first scatter writes i itself instead of reading an index array,
+ * the keys can be left untouched (the last pass then writes indices only)
+ * the scratch arrays are huge page arrays of sort_alloc.h
+ * radix_sort_columns sorts rows by several columns of their own width,
+ * signedness and direction (ORDER BY a, b DESC, ...) with the argsort, one
+ * column at a time from the last, without building a concatenated key
+ * COMPILE: gcc -O3 -pthread -o radix_sort_kv radix_sorting_kv.c
+ *          gcc -O3 -DRADIX_KV_BITS=8 -o radix_sort_kv radix_sorting_kv.c (8 passes of 8 bits)
+ *          gcc -O3 -DLIBSORT -c radix_sorting_kv.c (engine only, see libsort.h)
+ * RUN: ./radix_sort_kv [power]
+ * with a power argument only "power,size,cycles,ns,keys_per_s" is printed (data
+ * collection), the times are those of the uint64_t key + uint32_t row id sort
+ */
+
+#ifndef RADIX_KV_BITS
+#define RADIX_KV_BITS 11
+#endif
+
+#define MAX_DIGITS 8           // most passes of any key type (64 bit keys, 8 bit digits)
+#define MAX_RADIX (1 << 11)    // most buckets of any digit width
+#define COUNT_CHUNK ((size_t)1 << 31) // keys counted into one set of uint32_t histograms
+
+// the bits of signed and floating point keys are read through these, may_alias
+// makes reading a float array as integers well defined
+typedef uint32_t __attribute__((may_alias)) bits32_t;
+typedef uint64_t __attribute__((may_alias)) bits64_t;
+
+// order preserving maps to unsigned keys (TO_*) and back (FROM_*)
+#define TO_SAME(k) (k)
+#define FROM_SAME(k) (k)
+#define TO_SIGNED32(k) ((k) ^ 0x80000000u)
+#define FROM_SIGNED32(k) ((k) ^ 0x80000000u)
+#define TO_SIGNED64(k) ((k) ^ 0x8000000000000000ull)
+#define FROM_SIGNED64(k) ((k) ^ 0x8000000000000000ull)
+#define TO_FLOAT32(k) ((k) ^ (((uint32_t)((int32_t)(k) >> 31)) | 0x80000000u))
+#define FROM_FLOAT32(k) ((k) ^ (((uint32_t)((int32_t)~(k) >> 31)) | 0x80000000u))
+#define TO_FLOAT64(k) ((k) ^ (((uint64_t)((int64_t)(k) >> 63)) | 0x8000000000000000ull))
+#define FROM_FLOAT64(k) ((k) ^ (((uint64_t)((int64_t)~(k) >> 63)) | 0x8000000000000000ull))
+
+// mark the digits a pass has to sort on (a digit every key shares would only
+// copy), returns the number of passes
+static int count_passes(size_t (*counts)[MAX_RADIX], int digits, int radix, size_t size, int *needed) {
+    int passes = 0;
+    for (int d = 0; d < digits; d++) {
+        needed[d] = 1;
+        for (int b = 0; b < radix; b++) {
+            if (counts[d][b] == size) {
+                needed[d] = 0;
+            }
+        }
+        passes += needed[d];
+    }
+    return passes;
+}
+
+/* NAME(keys, size, counts, needed) builds the histograms of every digit of
+ * TO_KEY(keys[i]) in one read and marks the digits a pass has to sort on,
+ * returns the number of passes
+ * the read counts into uint32_t histograms (half the cache footprint of size_t)
+ * COUNT_CHUNK keys at a time and adds them up in the size_t counts
+ */
+#define DEFINE_RADIX_COUNT(NAME, KEY_T, KEY_BITS, DIGIT_BITS, TO_KEY)                              \
+static int NAME(const KEY_T *keys, size_t size, size_t (*counts)[MAX_RADIX], int *needed) {        \
+    const int radix = 1 << (DIGIT_BITS);                                                            \
+    const KEY_T mask = (KEY_T)(radix - 1);                                                          \
+    const int digits = ((KEY_BITS) + (DIGIT_BITS) - 1) / (DIGIT_BITS);                              \
+                                                                                                    \
+    uint32_t (*part)[MAX_RADIX] = malloc(digits * sizeof(*part));                                   \
+    if (!part) {                                                                                    \
+        perror("Failed to allocate memory");                                                        \
+        exit(EXIT_FAILURE);                                                                         \
+    }                                                                                               \
+    memset(counts, 0, digits * sizeof(*counts));                                                    \
+    for (size_t start = 0; start < size; start += COUNT_CHUNK) {                                    \
+        size_t end = (size - start > COUNT_CHUNK) ? start + COUNT_CHUNK : size;                     \
+        memset(part, 0, digits * sizeof(*part));                                                    \
+        for (size_t i = start; i < end; i++) {                                                      \
+            KEY_T key = TO_KEY(keys[i]);                                                            \
+            for (int d = 0; d < digits; d++) {                                                      \
+                part[d][(key >> (d * (DIGIT_BITS))) & mask]++;                                      \
+            }                                                                                       \
+        }                                                                                           \
+        for (int d = 0; d < digits; d++) {                                                          \
+            for (int b = 0; b < radix; b++) {                                                       \
+                counts[d][b] += part[d][b];                                                         \
+            }                                                                                       \
+        }                                                                                           \
+    }                                                                                               \
+    free(part);                                                                                     \
+                                                                                                    \
+    return count_passes(counts, digits, radix, size, needed);                                       \
+}
+
+// the byte histograms of 32 bit keys from the fused read of radix_sorting_simd.c,
+// flip_top moves the buckets of the top byte for keys whose sign bit is flipped
+static int count_bytes32(const uint32_t *keys, size_t size, uint32_t flip_top, size_t (*counts)[MAX_RADIX],
+                         int *needed) {
+    size_t part[4][HIST_RADIX];
+    histogram_all_bytes(keys, size, part);
+    for (int d = 0; d < 4; d++) {
+        uint32_t flip = (d == 3) ? flip_top : 0;
+        for (int b = 0; b < HIST_RADIX; b++) {
+            counts[d][b ^ flip] = part[d][b];
+        }
+    }
+    return count_passes(counts, 4, HIST_RADIX, size, needed);
+}
+
+static int radix_count_u32(const uint32_t *keys, size_t size, size_t (*counts)[MAX_RADIX], int *needed) {
+    return count_bytes32(keys, size, 0, counts, needed);
+}
+
+static int radix_count_i32(const bits32_t *keys, size_t size, size_t (*counts)[MAX_RADIX], int *needed) {
+    return count_bytes32((const uint32_t *)keys, size, 0x80, counts, needed); // TO_SIGNED32
+}
+
+/* NAME(keys, values, size) sorts keys and moves values[i] along with keys[i]
+ * KEY_BITS / DIGIT_BITS digits of the key, values is ignored unless HAS_VALUES
+ * TO_KEY maps a key's bits to an unsigned key of the same order, FROM_KEY back,
+ * COUNT is the DEFINE_RADIX_COUNT of the key type
+ * the scratch arrays are allocated per call and the result is copied back
+ * when an odd number of passes ran
+ */
+#define DEFINE_RADIX_KV(NAME, KEY_T, VALUE_T, KEY_BITS, DIGIT_BITS, HAS_VALUES, TO_KEY, FROM_KEY, COUNT) \
+static void NAME(KEY_T *keys, VALUE_T *values, size_t size) {                                       \
+    const int radix = 1 << (DIGIT_BITS);                                                            \
+    const KEY_T mask = (KEY_T)(radix - 1);                                                          \
+    const int digits = ((KEY_BITS) + (DIGIT_BITS) - 1) / (DIGIT_BITS);                              \
+                                                                                                    \
+    if (size < 2) {                                                                                 \
+        return;                                                                                     \
+    }                                                                                               \
+                                                                                                    \
+    /* scratch arrays on huge pages, see sort_alloc.h */                                            \
+    KEY_T *key_scratch = sort_alloc(size * sizeof(KEY_T), SORT_ALLOC_PREFAULT);                     \
+    VALUE_T *value_scratch = (HAS_VALUES) ?                                                         \
+        sort_alloc(size * sizeof(VALUE_T), SORT_ALLOC_PREFAULT) : NULL;                             \
+    size_t (*counts)[MAX_RADIX] = malloc(digits * sizeof(*counts));                                 \
+    if (!counts) {                                                                                  \
+        perror("Failed to allocate memory");                                                        \
+        exit(EXIT_FAILURE);                                                                         \
+    }                                                                                               \
+                                                                                                    \
+    int needed[MAX_DIGITS];                                                                         \
+    COUNT(keys, size, counts, needed);                                                              \
+    int first = -1, last = -1;                                                                      \
+    for (int d = 0; d < digits; d++) {                                                              \
+        if (needed[d]) {                                                                            \
+            first = (first < 0) ? d : first;                                                        \
+            last = d;                                                                               \
+        }                                                                                           \
+    }                                                                                               \
+                                                                                                    \
+    KEY_T *key_src = keys, *key_dst = key_scratch;                                                  \
+    VALUE_T *value_src = values, *value_dst = value_scratch;                                        \
+                                                                                                    \
+    for (int d = 0; d < digits; d++) {                                                              \
+        int shift = d * (DIGIT_BITS);                                                               \
+        size_t placements[MAX_RADIX];                                                               \
+        if (!needed[d]) {                                                                           \
+            continue;                                                                               \
+        }                                                                                           \
+                                                                                                    \
+        size_t placement = 0;                                                                       \
+        for (int b = 0; b < radix; b++) {                                                           \
+            placements[b] = placement;                                                              \
+            placement += counts[d][b];                                                              \
+        }                                                                                           \
+                                                                                                    \
+        /* key and payload leave in the same iteration, the first pass maps the */                  \
+        /* keys to unsigned order and the last one maps them back */                                \
+        int from_input = (d == first);                                                              \
+        int to_output = (d == last);                                                                \
+        for (size_t i = 0; i < size; i++) {                                                         \
+            KEY_T key = from_input ? TO_KEY(key_src[i]) : key_src[i];                               \
+            size_t p = placements[(key >> shift) & mask]++;                                         \
+            key_dst[p] = to_output ? FROM_KEY(key) : key;                                           \
+            if (HAS_VALUES) {                                                                       \
+                value_dst[p] = value_src[i];                                                        \
+            }                                                                                       \
+        }                                                                                           \
+                                                                                                    \
+        KEY_T *key_swap = key_src;                                                                  \
+        key_src = key_dst;                                                                          \
+        key_dst = key_swap;                                                                         \
+        VALUE_T *value_swap = value_src;                                                            \
+        value_src = value_dst;                                                                      \
+        value_dst = value_swap;                                                                     \
+    }                                                                                               \
+                                                                                                    \
+    /* an odd number of passes leaves the result in the scratch arrays */                           \
+    if (key_src != keys) {                                                                          \
+        memcpy(keys, key_src, size * sizeof(KEY_T));                                                \
+        if (HAS_VALUES) {                                                                           \
+            memcpy(values, value_src, size * sizeof(VALUE_T));                                      \
+        }                                                                                           \
+    }                                                                                               \
+                                                                                                    \
+    free(counts);                                                                                   \
+    sort_free(value_scratch, size * sizeof(VALUE_T));                                               \
+    sort_free(key_scratch, size * sizeof(KEY_T));                                                   \
+}
+
+/* NAME(keys, order, indices, size, sort_keys) argsort: indices[j] is the
+ * position in keys of the j-th smallest key (ties in input order)
+ * the index of keys[i] is i, or order[i] when order is given (a permutation
+ * from an earlier sort, order may be indices itself), the indices are created
+ * in the first scatter and ride along with the keys through every pass
+ * keys are left untouched unless sort_keys, then they end up sorted as well
+ */
+#define DEFINE_RADIX_ARGSORT(NAME, KEY_T, KEY_BITS, DIGIT_BITS, TO_KEY, FROM_KEY, COUNT)            \
+static void NAME(KEY_T *keys, const uint32_t *order, uint32_t *indices, size_t size,               \
+                 int sort_keys) {                                                                   \
+    const int radix = 1 << (DIGIT_BITS);                                                            \
+    const KEY_T mask = (KEY_T)(radix - 1);                                                          \
+    const int digits = ((KEY_BITS) + (DIGIT_BITS) - 1) / (DIGIT_BITS);                              \
+                                                                                                    \
+    size_t (*counts)[MAX_RADIX] = malloc(digits * sizeof(*counts));                                 \
+    if (!counts) {                                                                                  \
+        perror("Failed to allocate memory");                                                        \
+        exit(EXIT_FAILURE);                                                                         \
+    }                                                                                               \
+    int needed[MAX_DIGITS];                                                                         \
+    int passes = COUNT(keys, size, counts, needed);                                                 \
+                                                                                                    \
+    if (passes == 0) {                                                                              \
+        /* every key is equal, the order stays as it is */                                          \
+        for (size_t i = 0; i < size; i++) {                                                         \
+            indices[i] = order ? order[i] : (uint32_t)i;                                            \
+        }                                                                                           \
+        free(counts);                                                                               \
+        return;                                                                                     \
+    }                                                                                               \
+                                                                                                    \
+    /* keys ping-pong between two buffers (keys itself when it may be sorted), */                   \
+    /* the last pass writes no keys unless they are wanted */                                       \
+    int key_buffers = sort_keys ? 1 : (passes > 2 ? 2 : 1);                                         \
+    KEY_T *key_scratch = sort_alloc(key_buffers * size * sizeof(KEY_T), SORT_ALLOC_PREFAULT);       \
+    uint32_t *index_scratch = sort_alloc(size * sizeof(uint32_t), SORT_ALLOC_PREFAULT);             \
+    KEY_T *key_other = sort_keys ? keys : key_scratch + (key_buffers - 1) * size;                   \
+                                                                                                    \
+    /* start the indices in the buffer that makes the last pass land in indices, */                 \
+    /* unless order is indices and has to be read by the first pass */                              \
+    uint32_t *index_dst = ((passes & 1) && order != indices) ? indices : index_scratch;             \
+    const uint32_t *index_src = order;                                                              \
+    const KEY_T *key_src = keys;                                                                    \
+    KEY_T *key_dst = key_scratch;                                                                   \
+                                                                                                    \
+    int pass = 0;                                                                                   \
+    for (int d = 0; d < digits; d++) {                                                              \
+        int shift = d * (DIGIT_BITS);                                                               \
+        size_t placements[MAX_RADIX];                                                               \
+        if (!needed[d]) {                                                                           \
+            continue;                                                                               \
+        }                                                                                           \
+        pass++;                                                                                     \
+                                                                                                    \
+        size_t placement = 0;                                                                       \
+        for (int b = 0; b < radix; b++) {                                                           \
+            placements[b] = placement;                                                              \
+            placement += counts[d][b];                                                              \
+        }                                                                                           \
+                                                                                                    \
+        int from_input = (pass == 1);                                                               \
+        int to_output = (pass == passes);                                                           \
+        int write_keys = sort_keys || !to_output;                                                   \
+        for (size_t i = 0; i < size; i++) {                                                         \
+            KEY_T key = from_input ? TO_KEY(key_src[i]) : key_src[i];                               \
+            size_t p = placements[(key >> shift) & mask]++;                                         \
+            if (write_keys) {                                                                       \
+                key_dst[p] = to_output ? FROM_KEY(key) : key;                                       \
+            }                                                                                       \
+            index_dst[p] = from_input ? (index_src ? index_src[i] : (uint32_t)i) : index_src[i];    \
+        }                                                                                           \
+                                                                                                    \
+        key_src = key_dst;                                                                          \
+        key_dst = (key_dst == key_scratch) ? key_other : key_scratch;                               \
+        index_src = index_dst;                                                                      \
+        index_dst = (index_dst == indices) ? index_scratch : indices;                               \
+    }                                                                                               \
+                                                                                                    \
+    if (sort_keys && key_src != keys) {                                                             \
+        memcpy(keys, key_src, size * sizeof(KEY_T));                                                \
+    }                                                                                               \
+    if (index_src != indices) {                                                                     \
+        memcpy(indices, index_src, size * sizeof(uint32_t));                                        \
+    }                                                                                               \
+                                                                                                    \
+    sort_free(index_scratch, size * sizeof(uint32_t));                                              \
+    sort_free(key_scratch, key_buffers * size * sizeof(KEY_T));                                     \
+    free(counts);                                                                                   \
+}
+
+DEFINE_RADIX_COUNT(radix_count_u64, uint64_t, 64, RADIX_KV_BITS, TO_SAME)
+DEFINE_RADIX_COUNT(radix_count_f32, bits32_t, 32, 8, TO_FLOAT32)
+DEFINE_RADIX_COUNT(radix_count_i64, bits64_t, 64, RADIX_KV_BITS, TO_SIGNED64)
+DEFINE_RADIX_COUNT(radix_count_f64, bits64_t, 64, RADIX_KV_BITS, TO_FLOAT64)
+
+DEFINE_RADIX_KV(radix_kv_u64, uint64_t, uint32_t, 64, RADIX_KV_BITS, 0, TO_SAME, FROM_SAME, radix_count_u64)
+DEFINE_RADIX_KV(radix_kv_u64_u32, uint64_t, uint32_t, 64, RADIX_KV_BITS, 1, TO_SAME, FROM_SAME, radix_count_u64)
+DEFINE_RADIX_KV(radix_kv_u64_u64, uint64_t, uint64_t, 64, RADIX_KV_BITS, 1, TO_SAME, FROM_SAME, radix_count_u64)
+DEFINE_RADIX_KV(radix_kv_u32_u32, uint32_t, uint32_t, 32, 8, 1, TO_SAME, FROM_SAME, radix_count_u32)
+DEFINE_RADIX_KV(radix_kv_u32_u64, uint32_t, uint64_t, 32, 8, 1, TO_SAME, FROM_SAME, radix_count_u32)
+
+DEFINE_RADIX_KV(radix_kv_i32, bits32_t, uint32_t, 32, 8, 0, TO_SIGNED32, FROM_SIGNED32, radix_count_i32)
+DEFINE_RADIX_KV(radix_kv_i32_u32, bits32_t, uint32_t, 32, 8, 1, TO_SIGNED32, FROM_SIGNED32, radix_count_i32)
+DEFINE_RADIX_KV(radix_kv_f32, bits32_t, uint32_t, 32, 8, 0, TO_FLOAT32, FROM_FLOAT32, radix_count_f32)
+DEFINE_RADIX_KV(radix_kv_f32_u32, bits32_t, uint32_t, 32, 8, 1, TO_FLOAT32, FROM_FLOAT32, radix_count_f32)
+DEFINE_RADIX_KV(radix_kv_i64, bits64_t, uint32_t, 64, RADIX_KV_BITS, 0, TO_SIGNED64, FROM_SIGNED64, radix_count_i64)
+DEFINE_RADIX_KV(radix_kv_i64_u32, bits64_t, uint32_t, 64, RADIX_KV_BITS, 1, TO_SIGNED64, FROM_SIGNED64, radix_count_i64)
+DEFINE_RADIX_KV(radix_kv_f64, bits64_t, uint32_t, 64, RADIX_KV_BITS, 0, TO_FLOAT64, FROM_FLOAT64, radix_count_f64)
+DEFINE_RADIX_KV(radix_kv_f64_u32, bits64_t, uint32_t, 64, RADIX_KV_BITS, 1, TO_FLOAT64, FROM_FLOAT64, radix_count_f64)
+
+DEFINE_RADIX_ARGSORT(radix_arg_u32, uint32_t, 32, 8, TO_SAME, FROM_SAME, radix_count_u32)
+DEFINE_RADIX_ARGSORT(radix_arg_u64, uint64_t, 64, RADIX_KV_BITS, TO_SAME, FROM_SAME, radix_count_u64)
+DEFINE_RADIX_ARGSORT(radix_arg_i32, bits32_t, 32, 8, TO_SIGNED32, FROM_SIGNED32, radix_count_i32)
+DEFINE_RADIX_ARGSORT(radix_arg_f32, bits32_t, 32, 8, TO_FLOAT32, FROM_FLOAT32, radix_count_f32)
+DEFINE_RADIX_ARGSORT(radix_arg_i64, bits64_t, 64, RADIX_KV_BITS, TO_SIGNED64, FROM_SIGNED64, radix_count_i64)
+DEFINE_RADIX_ARGSORT(radix_arg_f64, bits64_t, 64, RADIX_KV_BITS, TO_FLOAT64, FROM_FLOAT64, radix_count_f64)
+
+void radix_sort_u64(uint64_t *keys, size_t size) {
+    radix_kv_u64(keys, NULL, size);
+}
+
+void radix_sort_u64_u32(uint64_t *keys, uint32_t *values, size_t size) {
+    radix_kv_u64_u32(keys, values, size);
+}
+
+void radix_sort_u64_u64(uint64_t *keys, uint64_t *values, size_t size) {
+    radix_kv_u64_u64(keys, values, size);
+}
+
+void radix_sort_u32_u32(uint32_t *keys, uint32_t *values, size_t size) {
+    radix_kv_u32_u32(keys, values, size);
+}
+
+void radix_sort_u32_u64(uint32_t *keys, uint64_t *values, size_t size) {
+    radix_kv_u32_u64(keys, values, size);
+}
+
+void radix_sort_i32(int32_t *keys, size_t size) {
+    radix_kv_i32((bits32_t *)keys, NULL, size);
+}
+
+void radix_sort_i32_u32(int32_t *keys, uint32_t *values, size_t size) {
+    radix_kv_i32_u32((bits32_t *)keys, values, size);
+}
+
+void radix_sort_f32(float *keys, size_t size) {
+    radix_kv_f32((bits32_t *)keys, NULL, size);
+}
+
+void radix_sort_f32_u32(float *keys, uint32_t *values, size_t size) {
+    radix_kv_f32_u32((bits32_t *)keys, values, size);
+}
+
+void radix_sort_i64(int64_t *keys, size_t size) {
+    radix_kv_i64((bits64_t *)keys, NULL, size);
+}
+
+void radix_sort_i64_u32(int64_t *keys, uint32_t *values, size_t size) {
+    radix_kv_i64_u32((bits64_t *)keys, values, size);
+}
+
+void radix_sort_f64(double *keys, size_t size) {
+    radix_kv_f64((bits64_t *)keys, NULL, size);
+}
+
+void radix_sort_f64_u32(double *keys, uint32_t *values, size_t size) {
+    radix_kv_f64_u32((bits64_t *)keys, values, size);
+}
+
+// argsort, indices gets the permutation that sorts keys (size < 2^32)
+// keys stay as they are unless sort_keys
+void radix_argsort_u32(uint32_t *keys, uint32_t *indices, size_t size, int sort_keys) {
+    radix_arg_u32(keys, NULL, indices, size, sort_keys);
+}
+
+void radix_argsort_u64(uint64_t *keys, uint32_t *indices, size_t size, int sort_keys) {
+    radix_arg_u64(keys, NULL, indices, size, sort_keys);
+}
+
+void radix_argsort_i32(int32_t *keys, uint32_t *indices, size_t size, int sort_keys) {
+    radix_arg_i32((bits32_t *)keys, NULL, indices, size, sort_keys);
+}
+
+void radix_argsort_f32(float *keys, uint32_t *indices, size_t size, int sort_keys) {
+    radix_arg_f32((bits32_t *)keys, NULL, indices, size, sort_keys);
+}
+
+void radix_argsort_i64(int64_t *keys, uint32_t *indices, size_t size, int sort_keys) {
+    radix_arg_i64((bits64_t *)keys, NULL, indices, size, sort_keys);
+}
+
+void radix_argsort_f64(double *keys, uint32_t *indices, size_t size, int sort_keys) {
+    radix_arg_f64((bits64_t *)keys, NULL, indices, size, sort_keys);
+}
+
+// keys[i] = column[order[i]] (column[i] without order) mapped to unsigned order,
+// inverted for a descending column
+static void gather_column(const libsort_column *column, const uint32_t *order, void *keys, size_t size) {
+    uint32_t *keys32 = keys;
+    uint64_t *keys64 = keys;
+    uint32_t flip32 = column->descending ? ~0u : 0;
+    uint64_t flip64 = column->descending ? ~0ull : 0;
+
+#define GATHER(OUT, IN_T, TO_KEY, FLIP)                                      \
+    do {                                                                      \
+        const IN_T *in = column->data;                                        \
+        for (size_t i = 0; i < size; i++) {                                   \
+            OUT[i] = TO_KEY(in[order ? order[i] : i]) ^ (FLIP);               \
+        }                                                                     \
+    } while (0)
+
+    switch (column->type) {
+    case LIBSORT_KEY_U32: GATHER(keys32, uint32_t, TO_SAME, flip32); break;
+    case LIBSORT_KEY_I32: GATHER(keys32, bits32_t, TO_SIGNED32, flip32); break;
+    case LIBSORT_KEY_F32: GATHER(keys32, bits32_t, TO_FLOAT32, flip32); break;
+    case LIBSORT_KEY_U64: GATHER(keys64, uint64_t, TO_SAME, flip64); break;
+    case LIBSORT_KEY_I64: GATHER(keys64, bits64_t, TO_SIGNED64, flip64); break;
+    case LIBSORT_KEY_F64: GATHER(keys64, bits64_t, TO_FLOAT64, flip64); break;
+    }
+#undef GATHER
+}
+
+// stable sort by columns[0], then columns[1], ..., perm gets the row order (size < 2^32)
+// the columns are sorted on from the last one to the first, each one gathered
+// through the permutation so far into unsigned keys and argsorted starting from
+// that permutation, the stability of every pass keeps the order of the columns after it
+void radix_sort_columns(const libsort_column *columns, int num_columns, uint32_t *perm, size_t size) {
+    if (num_columns < 1 || size < 2) {
+        for (size_t i = 0; i < size; i++) {
+            perm[i] = (uint32_t)i;
+        }
+        return;
+    }
+
+    // gathered keys of one column, also the key ping-pong buffer of its passes
+    void *keys = sort_alloc(size * sizeof(uint64_t), SORT_ALLOC_PREFAULT);
+
+    for (int c = num_columns - 1; c >= 0; c--) {
+        // the least significant column starts from the row order itself
+        const uint32_t *order = (c == num_columns - 1) ? NULL : perm;
+        gather_column(&columns[c], order, keys, size);
+        if (columns[c].type == LIBSORT_KEY_U64 || columns[c].type == LIBSORT_KEY_I64 ||
+            columns[c].type == LIBSORT_KEY_F64) {
+            radix_arg_u64(keys, order, perm, size, 1);
+        } else {
+            radix_arg_u32(keys, order, perm, size, 1);
+        }
+    }
+
+    sort_free(keys, size * sizeof(uint64_t));
+}
+
+#ifndef LIBSORT
+int main(int argc, char *argv[]) {
+    // FOR DATA COLLECTION pass the power of two of the array size
+    int collect = (argc == 2);
+    int power = collect ? atoi(argv[1]) : 24;
+    size_t size = (size_t)1 << power;
+
+    // 64 bit keys with a 32 bit row id, and a copy of the keys for the key only sort
+    uint64_t *keys = malloc(size * sizeof(uint64_t));
+    uint64_t *original = malloc(size * sizeof(uint64_t));
+    uint32_t *rows = malloc(size * sizeof(uint32_t));
+    if (!keys || !original || !rows) {
+        perror("Failed to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+
+    data_fill_u64(keys, size, data_spec_of(DATA_UNIFORM), (uint64_t)time(NULL), 0);
+    memcpy(original, keys, size * sizeof(uint64_t));
+    data_checksum checksum = data_checksum_u64(keys, size, 0);
+    for (size_t i = 0; i < size; i++) {
+        rows[i] = (uint32_t)i;
+    }
+
+    uint64_t start, end, kv_time, key_time;
+
+    start = rdtsc_start();
+    radix_sort_u64_u32(keys, rows, size);
+    end = rdtsc_stop();
+    kv_time = end - start;
+
+    // the keys are sorted and the same keys, every row id still points at its key,
+    // equal keys keep ascending row ids
+    if (!data_verify_u64(keys, size, checksum, 0)) {
+        printf("Key value radix sorting failed.\n");
+        return 1;
+    }
+    for (size_t i = 0; i < size; i++) {
+        if ((i > 0 && keys[i - 1] == keys[i] && rows[i - 1] > rows[i]) || original[rows[i]] != keys[i]) {
+            printf("Key value radix sorting failed.\n");
+            return 1;
+        }
+    }
+
+    start = rdtsc_start();
+    radix_sort_u64(original, size);
+    end = rdtsc_stop();
+    key_time = end - start;
+
+    if (memcmp(original, keys, size * sizeof(uint64_t)) != 0) {
+        printf("Key radix sorting failed.\n");
+        return 1;
+    }
+
+    if (collect) {
+        printf("%d,%zu,%lu,%.0f,%.0f\n", power, size, kv_time, timing_ns(kv_time), timing_keys_per_s(kv_time, size));
+    } else {
+        printf("uint64 key + uint32 row sort time (%d bit digits): " TIMING_FMT "\n", RADIX_KV_BITS,
+               TIMING_ARGS(kv_time, size));
+        printf("uint64 key sort time: " TIMING_FMT "\n", TIMING_ARGS(key_time, size));
+        printf("done and validated\n");
+    }
+
+    free(rows);
+    free(original);
+    free(keys);
+    return 0;
+}
+#endif
@@ -4,67 +4,215 @@
 #include <time.h>
 #include <immintrin.h>
 #include <string.h>
+#include <unistd.h>
+#include "sort_timing.h"
+#include "sort_data.h"
+#include "radix_histogram.h"
+#include "sort_alloc.h"
+#include "perf_counters.h"
+#include "libsort.h"
 
 /* Code for SIMD vectorization of radix sort using intel AVX2 intrinsics
- * COMPILE: gcc -O3 -mavx2 -o radix_sort_simd radix_sorting_simd.c
- * RUN: ./radix_sort_simd
+ * COMPILE: gcc -O3 -mavx2 -pthread -o radix_sort_simd radix_sorting_simd.c
+ *          gcc -O3 -mavx2 -DWC_SCATTER=1 -o radix_sort_simd_wc radix_sorting_simd.c
+ *          gcc -O3 -mavx2 -DSORT_ALLOC_HUGE=0 -o radix_sort_simd_4k radix_sorting_simd.c (4 KB pages)
+ *          gcc -O3 -mavx2 -DSORT_PERF=1 -o radix_sort_simd_perf radix_sorting_simd.c perf_counters.c
+ *          gcc -O3 -mavx2 -DLIBSORT -c radix_sorting_simd.c (engine only, see libsort.h)
+ * the scratch array and the input of main are huge page arrays of sort_alloc.h,
+ * faulted in before the sort starts
+ * RUN: ./radix_sort_simd [power]
+ * with a power argument only "power,size,cycles,ns,keys_per_s" is printed (data collection)
  */
 
-// function for timing cpu cycles
-static inline uint64_t rdtsc() {
-	unsigned long a, d;
-	asm volatile("rdtsc" : "=a"(a), "=d"(d));
-	return a | ((uint64_t)d << 32);
+// FUSED_HISTOGRAM 1: count all 4 bytes in a single read before the first scatter
+// and skip passes whose byte is the same for every key
+// FUSED_HISTOGRAM 0: rebuild the histogram at the top of every pass
+#ifndef FUSED_HISTOGRAM
+#define FUSED_HISTOGRAM 1
+#endif
+
+// WC_SCATTER 1: stage keys in one cache line buffer per bucket and write whole
+// lines to the output (streaming stores once the output is larger than the LLC)
+// WC_SCATTER 0: write every key straight to its bucket
+#ifndef WC_SCATTER
+#define WC_SCATTER 0
+#endif
+
+// the write-combining build exports its engine under its own name, so libsort
+// links both builds (LIBSORT_RADIX_SIMD and LIBSORT_RADIX_SIMD_WC)
+#if WC_SCATTER
+#define RADIX_SORT_SIMD radix_sort_simd_wc
+#else
+#define RADIX_SORT_SIMD radix_sort_simd
+#endif
+
+#define WC_KEYS 16 // keys per staging buffer, 16 * 4 bytes = one 64 byte cache line
+
+#if WC_SCATTER
+// size of the last level cache in bytes, used to decide on streaming stores
+static size_t llc_bytes() {
+	long llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+	return llc > 0 ? (size_t)llc : (size_t)32 << 20;
 }
 
-// Avoid making changes to this function skeleton, apart from data type changes if required
-// In this starter code we have used uint32_t, feel free to change it to any other data type if required
-void sort_array(uint32_t *arr, size_t size) {
-	// Enter your logic here
-		// allocate space for array used in sorting
-	uint32_t *sorting_arr = malloc(size * sizeof(uint32_t));
-	if (!sorting_arr) {
-        perror("Failed to allocate memory");
-        exit(EXIT_FAILURE);
+// write-combining scatter of one pass from src into dst
+// keys are staged in a per bucket buffer whose slots line up with the cache lines
+// of dst, so every full buffer is flushed as one aligned 64 byte line
+static void scatter_wc(const uint32_t *src, uint32_t *dst, size_t size, int shift,
+                       const size_t *placements, int stream) {
+	const int RADIX = 256;
+	const int MASK = RADIX - 1;
+
+	uint32_t buffers[RADIX][WC_KEYS] __attribute__((aligned(64)));
+	size_t begin[RADIX]; // first output index of each bucket
+	size_t pos[RADIX];   // next output index of each bucket
+
+	// number of keys dst sits past a cache line boundary, index p of dst
+	// lives in slot (p + skew) % WC_KEYS of its line
+	size_t skew = ((uintptr_t)dst & 63) / sizeof(uint32_t);
+
+	for (int b = 0; b < RADIX; b++) {
+		begin[b] = placements[b];
+		pos[b] = placements[b];
+	}
+
+	for (size_t i = 0; i < size; i++) {
+		uint32_t value = src[i];
+		int b = (value >> shift) & MASK;
+		size_t p = pos[b]++;
+		size_t slot = (p + skew) & (WC_KEYS - 1);
+		buffers[b][slot] = value;
+
+		// flush when the last slot of the line is written
+		if (slot == WC_KEYS - 1) {
+			if (p + 1 >= begin[b] + WC_KEYS) {
+				// full line, dst + p - 15 is 64 byte aligned
+				__m256i *out = (__m256i *)&dst[p + 1 - WC_KEYS];
+				__m256i lo = _mm256_load_si256((__m256i *)&buffers[b][0]);
+				__m256i hi = _mm256_load_si256((__m256i *)&buffers[b][8]);
+				if (stream) {
+					_mm256_stream_si256(out, lo);
+					_mm256_stream_si256(out + 1, hi);
+				} else {
+					_mm256_store_si256(out, lo);
+					_mm256_store_si256(out + 1, hi);
+				}
+			} else {
+				// first line of the bucket, the front of the line belongs to the bucket before
+				size_t first = (begin[b] + skew) & (WC_KEYS - 1);
+				memcpy(&dst[begin[b]], &buffers[b][first], (WC_KEYS - first) * sizeof(uint32_t));
+			}
+		}
 	}
 
+	// flush the partly filled last line of every bucket
+	for (int b = 0; b < RADIX; b++) {
+		size_t filled = (pos[b] + skew) & (WC_KEYS - 1);
+		// the line may also hold the end of the bucket before
+		size_t first = (filled > pos[b] - begin[b]) ? begin[b] : pos[b] - filled;
+		if (first < pos[b]) {
+			memcpy(&dst[first], &buffers[b][(first + skew) & (WC_KEYS - 1)], (pos[b] - first) * sizeof(uint32_t));
+		}
+	}
+
+	// order the streaming stores before the next pass reads dst
+	if (stream) {
+		_mm_sfence();
+	}
+}
+#endif
+
+#if FUSED_HISTOGRAM && SORT_PERF
+// phase of the fused histogram read, named after the kernel histogram_all_bytes
+// picked, so the phase table (sort_bench -P) shows which one ran
+static const char *histogram_phase(void) {
+	const char *kernel = histogram_all_name();
+	if (strcmp(kernel, "avx512") == 0) {
+		return "radix_simd.histogram_avx512";
+	}
+	if (strcmp(kernel, "avx2") == 0) {
+		return "radix_simd.histogram_avx2";
+	}
+	return "radix_simd.histogram_scalar";
+}
+#endif
+
+// SIMD radix sort
+void RADIX_SORT_SIMD(uint32_t *arr, size_t size) {
+	if (size < 2) {
+		return;
+	}
+
+	// allocate space for array used in sorting, on huge pages and faulted in
+	// up front instead of one 4 KB fault at a time inside the first scatter
+	uint32_t *sorting_arr = sort_alloc(size * sizeof(uint32_t), SORT_ALLOC_PREFAULT);
+
 	// use radix base of 256 (one byte)	
 	const int RADIX = 256;	
-	const int MASK = RADIX - 1; // mask for 8 bits (0xFF)
+#if !WC_SCATTER
+	const int MASK = RADIX - 1; // mask for 8 bits (0xFF), scatter_wc has its own
+#endif
 
 	// aligned arrays for historgram and placements of elements (buckets)
-	uint32_t counts[RADIX] __attribute__((aligned(32)));
-	uint32_t placements[RADIX] __attribute__((aligned(32)));
+	// size_t, so a bucket can pass 2^32 keys
+	size_t counts[RADIX] __attribute__((aligned(32)));
+	size_t placements[RADIX] __attribute__((aligned(32)));
+
+	// remember the caller's array, skipped passes can leave the result in the scratch array
+	uint32_t *input = arr;
+	uint32_t *scratch = sorting_arr;
+
+#if WC_SCATTER
+	// bypass the cache when the output of a pass can't stay in the LLC anyway
+	int stream = size * sizeof(uint32_t) > llc_bytes();
+#endif
+
+#if FUSED_HISTOGRAM
+	// one read of the input gives the histograms of all 4 bytes
+	size_t all_counts[4][RADIX] __attribute__((aligned(32)));
+	PERF_PHASE_BEGIN(histogram_start);
+	histogram_all_bytes(arr, size, all_counts);
+	PERF_PHASE_END(histogram_start, histogram_phase(), 0);
+#endif
 
 	// main sorting loop
 	// sort by each byte from least to most significant (4 digits bc 4 bytes in unint32_t)
     for (int digit = 0; digit < 4; digit++) {
-		
-		memset(counts, 0, sizeof(counts)); // zero out the histogram for curr byte
-        __m256i mask = _mm256_set1_epi32(MASK); // mask to extract one byte
-        __m256i shift = _mm256_set1_epi32(digit * 8); // shift amount for curr byte	
 
-		// count the instances of each number at the current byte
-        for (size_t i = 0; i < size; i += 8) {
-            // parallelized simd extraction of byte values 8 integers at a time 
-            __m256i elements = _mm256_loadu_si256((__m256i *)&arr[i]); // load 8 ints
-            __m256i shifted = _mm256_srlv_epi32(elements, shift); // bit shift to target byte
-            __m256i byte = _mm256_and_si256(shifted, mask); // extract  byte
-                    
-            // serial incrementation of the histogram
-            for (int j = 0; j < 8; j++) {
-                counts[_mm256_extract_epi32(byte, j)]++;
-            }
+#if FUSED_HISTOGRAM
+        // every key has the same byte here, so this pass would only copy the array
+        if (histogram_is_trivial_wide(all_counts[digit], size)) {
+            continue;
         }
+        memcpy(counts, all_counts[digit], sizeof(counts));
+#else
+		// count the instances of each number at the current byte
+        // (vectorized sub-histogram kernel picked by CPUID, see radix_histogram.h)
+        PERF_PHASE_BEGIN(histogram_start);
+        histogram_wide(arr, size, digit * 8, counts);
+        PERF_PHASE_END(histogram_start, "radix_simd.histogram", digit);
+#endif
 
         // convert counts from the histogram into placements
+        PERF_PHASE_BEGIN(prefix_start);
         placements[0] = 0;
         for (int i = 1; i < RADIX; i++) {
             placements[i] = placements[i - 1] + counts[i - 1];
         }
+        PERF_PHASE_END(prefix_start, "radix_simd.prefix", digit);
+
+        PERF_PHASE_BEGIN(scatter_start);
+
+#if WC_SCATTER
+        // sort array through the write-combining buffers
+        scatter_wc(arr, sorting_arr, size, digit * 8, placements, stream);
+#else
+        __m256i mask = _mm256_set1_epi32(MASK); // mask to extract one byte
+        __m256i shift = _mm256_set1_epi32(digit * 8); // shift amount for curr byte	
 
         // sort array based on histogram placements and current byte
-        for (size_t i = 0; i < size; i += 8) {
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
             // parellelized byte extraction
             __m256i elements = _mm256_loadu_si256((__m256i *)&arr[i]); // load 8 ints
             __m256i shifted = _mm256_srlv_epi32(elements, shift); // shift to target byte
@@ -77,6 +225,12 @@ void sort_array(uint32_t *arr, size_t size) {
                 placements[digit_value]++;
             }
         }
+        // leftover elements when size is not a multiple of 8
+        for (; i < size; i++) {
+            sorting_arr[placements[(arr[i] >> (digit * 8)) & MASK]++] = arr[i];
+        }
+#endif
+        PERF_PHASE_END(scatter_start, "radix_simd.scatter", digit);
 
         // rotate pointers from the sorting array to the sorted array
         uint32_t *swap = arr;
@@ -84,71 +238,76 @@ void sort_array(uint32_t *arr, size_t size) {
         sorting_arr = swap;
     }
 	
+	// an odd number of passes leaves the result in the scratch array
+	if (arr != input) {
+		memcpy(input, arr, size * sizeof(uint32_t));
+	}
+
 	// cleanup sorting array 
-	free(sorting_arr); 
+	sort_free(scratch, size * sizeof(uint32_t));
+}
+
+#ifndef LIBSORT
+// Avoid making changes to this function skeleton, apart from data type changes if required
+// In this starter code we have used uint32_t, feel free to change it to any other data type if required
+void sort_array(uint32_t *arr, size_t size) {
+	RADIX_SORT_SIMD(arr, size);
 }
 
 // main
-// UNCOMMENT FOR DATA COLELCTION 
-int main(/*int argc, char *argv[]*/) {
+int main(int argc, char *argv[]) {
 	
-	// FOR DATA COLLECTION 
-	// if (argc != 2) {
-	// 	printf("Usage: %s <power>\n", argv[0]);
-	//	return 1;
-	// }
-	// int power = atoi(argv[1]);
-    // size_t size = 1 << power;
-	
-	// REMOVE FOR DATA COLLECTION
-	// initialize random unssorted array
-	size_t size = 1 << 30; // 2^30 elements (4GB given elements are unit32_t)
+	// FOR DATA COLLECTION pass the power of two of the array size
+	int collect = (argc == 2);
+	int power = collect ? atoi(argv[1]) : 30;
+	size_t size = (size_t)1 << power; // default 2^30 elements (4GB given elements are unit32_t)
 
     // allocate space for arrays for each sorting algo (simd vs vanilla)
-	uint32_t *arr = malloc(size * sizeof(uint32_t));
-	if (!arr) {
-		perror("Failed to allocate memory");
-		exit(EXIT_FAILURE);
-	}
+	uint32_t *arr = sort_alloc(size * sizeof(uint32_t), SORT_ALLOC_PREFAULT);
 
 	// fill the arrays with (the same) random numbers
-    srand((unsigned)time(NULL));
-    for (size_t i = 0; i < size; i++) {
-        arr[i] = rand();
-    }
+    data_fill_u32(arr, size, data_spec_of(DATA_UNIFORM), (uint64_t)time(NULL), 0);
+    data_checksum checksum = data_checksum_u32(arr, size, 0);
 
 	// declare variables for timing
 	uint64_t start, end, time;
     
 	// SIMD radix sorting and timing
-	start = rdtsc();
+#if SORT_PERF
+	perf_open();
+#endif
+	start = rdtsc_start();
 	// Sort the copied array
 	sort_array(arr, size);
-	end = rdtsc();
+	end = rdtsc_stop();
 	time = end - start;
+#if SORT_PERF
+	// phase breakdown on stderr, stdout keeps its format
+	perf_print(stderr);
+	perf_close();
+#endif
 	
-	// FOR DATA COLLECTION
-    // printf("%d,%zu,%lu\n", power, size, time);
-	
-	// REMOVE FOR DATA COLLECTION
-	printf("SIMD sort time: %lu cycles\n", time);
+	if (collect) {
+		printf("%d,%zu,%lu,%.0f,%.0f\n", power, size, time, timing_ns(time), timing_keys_per_s(time, size));
+	} else {
+		printf("SIMD sort time: " TIMING_FMT "\n", TIMING_ARGS(time, size));
+	}
 
 	// validate sorting 
-	for (size_t i = 1; i < size; i++) {
-		if (arr[i - 1] > arr[i]) {
-			printf("Simd sorting failed.\n");
-			// cleanup on failure
-			free(arr);
-			return 1;
-		}
-		// printf("%d\n", arr[i]);
+	if (!data_verify_u32(arr, size, checksum, 0)) {
+		printf("Simd sorting failed.\n");
+		// cleanup on failure
+		sort_free(arr, size * sizeof(uint32_t));
+		return 1;
 	}
 	
-	// REMOVE FOR DATA COLLECTION
-	printf("done and validated\n");
+	if (!collect) {
+		printf("done and validated\n");
+	}
 
 	// cleanup
-	free(arr);
+	sort_free(arr, size * sizeof(uint32_t));
 
 	return 0;
 }
+#endif
@@ -3,23 +3,24 @@
 #include <stdint.h>
 #include <time.h>
 #include <string.h>
+#include "sort_timing.h"
+#include "sort_data.h"
+#include "perf_counters.h"
+#include "libsort.h"
 
 /* Code for vanilla radix sort
- * COMPILE: gcc -o radix_sort_vanilla radix_sorting_vanilla.c
- * RUN: ./radix_sort_simd
+ * COMPILE: gcc -pthread -o radix_sort_vanilla radix_sorting_vanilla.c
+ *          gcc -DSORT_PERF=1 -o radix_sort_vanilla_perf radix_sorting_vanilla.c perf_counters.c
+ *          gcc -DLIBSORT -c radix_sorting_vanilla.c (engine only, see libsort.h)
+ * RUN: ./radix_sort_vanilla [power]
+ * with a power argument only "power,size,cycles,ns,keys_per_s" is printed (data collection)
  */
 
-// function for timing cpu cycles
-static inline uint64_t rdtsc() {
-	unsigned long a, d;
-	asm volatile("rdtsc" : "=a"(a), "=d"(d));
-	return a | ((uint64_t)d << 32);
-}
-
-// Avoid making changes to this function skeleton, apart from data type changes if required
-// In this starter code we have used uint32_t, feel free to change it to any other data type if required
 // vanilla radix sort
-void sort_array(uint32_t *arr, size_t size) {
+void radix_sort_vanilla(uint32_t *arr, size_t size) {
+	if (size < 2) {
+		return;
+	}
 
 	// use radix of base-10
 	const int RADIX = 10;
@@ -41,53 +42,66 @@ void sort_array(uint32_t *arr, size_t size) {
 
     // main sorting loop
     // sort by each digit from least to most significant
-    for (uint32_t exponent = 1; max_value/exponent > 0; exponent *= RADIX) {
+    int digit_index = 0; // level of the phase counters (perf_counters.h)
+    for (uint32_t exponent = 1; max_value/exponent > 0; exponent *= RADIX, digit_index++) {
         // histogram for current digit
         int count[RADIX];
         memset(count, 0, sizeof(count));
 
         // count each instance of each number at current digit
+        PERF_PHASE_BEGIN(histogram_start);
         for (size_t i = 0; i < size; i++) {
             count[(arr[i] / exponent) % RADIX]++;
         }
+        PERF_PHASE_END(histogram_start, "radix_vanilla.histogram", digit_index);
 
         // convert counts into placements in histogram
+        PERF_PHASE_BEGIN(prefix_start);
         for (int i = 1; i < RADIX; i++) {
             count[i] += count[i - 1];
         }
+        PERF_PHASE_END(prefix_start, "radix_vanilla.prefix", digit_index);
 
         // sort array based on histogram placements and current digit
-        for (int i = size - 1; i >= 0; i--) {
+        PERF_PHASE_BEGIN(scatter_start);
+        for (size_t i = size; i-- > 0;) {
             uint32_t digit = (arr[i] / exponent) % RADIX;
             count[digit]--;
             sorting_arr[count[digit]] = arr[i];
         }
+        PERF_PHASE_END(scatter_start, "radix_vanilla.scatter", digit_index);
 
         // copy sorted array for current digit back to origional array
+        PERF_PHASE_BEGIN(copy_start);
         for (size_t i = 0; i < size; i++) {
             arr[i] = sorting_arr[i];
         }
+        PERF_PHASE_END(copy_start, "radix_vanilla.copy", digit_index);
+
+        // stop before exponent overflows for keys with 10 decimal digits
+        if (exponent > UINT32_MAX / RADIX) {
+            break;
+        }
     }
 
 	// claenup temporary sorting array
     free(sorting_arr);
 }
 
-// main
-// UNCOMMENT FOR DATA COLELCTION 
-int main(/*int argc, char *argv[]*/) {
+#ifndef LIBSORT
+// Avoid making changes to this function skeleton, apart from data type changes if required
+// In this starter code we have used uint32_t, feel free to change it to any other data type if required
+void sort_array(uint32_t *arr, size_t size) {
+	radix_sort_vanilla(arr, size);
+}
 
-    // FOR DATA COLLECTION 
-    // if (argc != 2) {
-    //     printf("Usage: %s <power>\n", argv[0]);
-    //     return 1;
-    // }
-    // int power = atoi(argv[1]);
-    // size_t size = 1 << power;
+// main
+int main(int argc, char *argv[]) {
 
-    // REMOVE FOR DATA COLLECTION
-	// initialize random unssorted array
-	size_t size = 1 << 30; // 2^30 elements (4GB given elements are unit32_t)
+    // FOR DATA COLLECTION pass the power of two of the array size
+    int collect = (argc == 2);
+    int power = collect ? atoi(argv[1]) : 30;
+    size_t size = (size_t)1 << power; // default 2^30 elements (4GB given elements are unit32_t)
 
     // initialize random unssorted array	
     uint32_t *arr = malloc(size * sizeof(uint32_t));
@@ -97,43 +111,48 @@ int main(/*int argc, char *argv[]*/) {
     }
 
     // fill the arrays with (the same) random numbers
-    srand((unsigned)time(NULL));
-    for (size_t i = 0; i < size; i++) {
-        arr[i] = rand();
-    }
+    data_fill_u32(arr, size, data_spec_of(DATA_UNIFORM), (uint64_t)time(NULL), 0);
+    data_checksum checksum = data_checksum_u32(arr, size, 0);
 
     // declare variables for timing
     uint64_t start, end, time;
     
     // SIMD radix sorting and timing
-    start = rdtsc();
+#if SORT_PERF
+    perf_open();
+#endif
+    start = rdtsc_start();
     // Sort the copied array
     sort_array(arr, size);
-    end = rdtsc();
+    end = rdtsc_stop();
     time = end - start;
-
-	// FOR DATA COLLECTION
-    // printf("%d,%zu,%lu\n", power, size, time);
-	
-	// REMOVE FOR DATA COLLECTION
-	printf("Vanilla sort time: %lu cycles\n", time);
+#if SORT_PERF
+    // phase breakdown on stderr, stdout keeps its format
+    perf_print(stderr);
+    perf_close();
+#endif
+
+    if (collect) {
+        printf("%d,%zu,%lu,%.0f,%.0f\n", power, size, time, timing_ns(time), timing_keys_per_s(time, size));
+    } else {
+        printf("Vanilla sort time: " TIMING_FMT "\n", TIMING_ARGS(time, size));
+    }
 
     // validate sorting 
-    for (size_t i = 1; i < size; i++) {
-        if (arr[i - 1] > arr[i]) {
-            printf("Simd sorting failed.\n");
-            // cleanup on failure
-            free(arr);
-            return 1;
-        }
-        // printf("%d\n", arr[i]);
+    if (!data_verify_u32(arr, size, checksum, 0)) {
+        printf("Simd sorting failed.\n");
+        // cleanup on failure
+        free(arr);
+        return 1;
     }
 	
-    // REMOVE FOR DATA COLLECTION
-	printf("done and validated\n");
+    if (!collect) {
+        printf("done and validated\n");
+    }
 
     // cleanup
     free(arr);
 
     return 0;
 }
+#endif
@@ -1,283 +1,286 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
-#include <immintrin.h>
+#include <time.h>
 #include <pthread.h>
 #include <string.h>
-#include <math.h>
-
-#define NUM_THREADS 4
-#define NUM_LOCKS 10
-#define NUM_RESOURCES 10
-
-// Shared resources
-//int resources[NUM_RESOURCES];
-
-// Mutexes for shared resources
-pthread_mutex_t locks[NUM_LOCKS];
+#include <unistd.h>
+#include "sort_timing.h"
+#include "sort_data.h"
+#include "sort_alloc.h"
+#include "libsort.h"
+
+/* Code for multithreaded LSD radix sort (256 buckets, one byte per pass)
+ * every thread histograms its own chunk, a global exclusive prefix sum over
+ * (bucket, thread) hands each thread private write offsets, and the scatter
+ * then runs with no locks at all, passes whose byte is the same for every key
+ * (the high bytes of small keys) are skipped
+ * the scratch array comes from sort_alloc.h (huge pages) and every thread
+ * first-touches its own chunk of it, which places the chunk on the thread's
+ * NUMA node, the input of main is interleaved over the nodes
+ * COMPILE: gcc -O3 -pthread -o radix_threads radix_threads.c
+ *          gcc -O3 -pthread -DLIBSORT -c radix_threads.c (engine only, see libsort.h)
+ * RUN: ./radix_threads [power] [threads]
+ */
+
+#define RADIX 256
+#define MASK (RADIX - 1)   // mask for 8 bits (0xFF)
+#define MAX_THREADS 256
+
+// state shared by every thread of one sort
+typedef struct {
+    uint32_t *arr;          // input array, also holds the result
+    uint32_t *sorting_arr;  // scratch array of the same size
+    size_t size;
+    int num_threads;
+    size_t (*counts)[RADIX]; // one histogram per thread, counts[thread][bucket]
+    pthread_barrier_t barrier;
+} RadixShared;
 
 typedef struct {
-    int *arr;
-    int exp;
-    int *count;
+    RadixShared *shared;
     int thread_id;
-    int *output;
-    int n;
 } ThreadArgs;
 
-static inline uint64_t rdtsc() {
-    unsigned long a, d;
-    asm volatile("rdtsc" : "=a"(a), "=d"(d));
-    return a | ((uint64_t)d << 32);
-}
-
-
-// Avoid making changes to this function skeleton, apart from data type changes if
-//required
-// In this starter code we have used uint32_t, feel free to change it to any other
-//data type if required
-
-void* threadFunction(void* arg) {
-    ThreadArgs* threadArgs = (ThreadArgs*)arg; 
-    //int thread_id = *(int*)arg;
-    int *arr = threadArgs->arr;
-    int exp = threadArgs->exp;
-    int *count = threadArgs->count;
+// one worker runs all 4 byte passes over its own chunk of the array
+static void* threadFunction(void* arg) {
+    ThreadArgs *threadArgs = (ThreadArgs *)arg;
+    RadixShared *shared = threadArgs->shared;
     int thread_id = threadArgs->thread_id;
-    int *output = threadArgs->output;
-    int n = threadArgs->n;
+    int num_threads = shared->num_threads;
 
-    //int min_idx = (n / NUM_THREADS) * thread_id;
-    //int max_idx = min_idx + (n / NUM_THREADS);
+    // chunk boundaries stay fixed across passes
+    size_t min_idx = shared->size * thread_id / num_threads;
+    size_t max_idx = shared->size * (thread_id + 1) / num_threads;
 
-    int min_idx = floor((double)n / NUM_THREADS * thread_id);
-    int max_idx = floor((double)n / NUM_THREADS * (thread_id + 1));
-    printf("min idx = %d; max idx = %d\n", min_idx, max_idx);
+    uint32_t *src = shared->arr;
+    uint32_t *dst = shared->sorting_arr;
+    size_t *count = shared->counts[thread_id];
+    size_t offsets[RADIX];
 
-    for (int i = max_idx - 1; i >= min_idx; i--) {
-        int digit = (arr[i] / exp) % 10;
+    // first touch of this thread's chunk of the scratch array
+    sort_prefault_range(dst + min_idx, (max_idx - min_idx) * sizeof(uint32_t));
 
-	pthread_mutex_lock(&locks[digit]);
-        output[count[digit] - 1] = arr[i];
-        count[digit]--;
-	pthread_mutex_unlock(&locks[digit]);
-    }
+    for (int digit = 0; digit < 4; digit++) {
+        int shift = digit * 8;
 
+        // private histogram of this thread's chunk
+        memset(count, 0, RADIX * sizeof(size_t));
+        for (size_t i = min_idx; i < max_idx; i++) {
+            count[(src[i] >> shift) & MASK]++;
+        }
 
-    free(arg); // Free allocated memory for thread ID
-    return NULL;
-}
+        // wait until every histogram is complete
+        pthread_barrier_wait(&shared->barrier);
+
+        // exclusive prefix sum in (bucket, thread) order: bucket b of this thread
+        // starts after all smaller buckets and after bucket b of lower threads
+        size_t offset = 0;
+        int trivial = 0;
+        for (int b = 0; b < RADIX; b++) {
+            size_t bucket_start = offset;
+            for (int t = 0; t < num_threads; t++) {
+                if (t == thread_id) {
+                    offsets[b] = offset;
+                }
+                offset += shared->counts[t][b];
+            }
+            trivial |= (offset - bucket_start == shared->size);
+        }
 
+        // every key has the same byte here (high bytes of small keys), every
+        // thread sees the same totals so they all skip the pass together
+        if (trivial) {
+            pthread_barrier_wait(&shared->barrier);
+            continue;
+        }
 
+        // lock free scatter, the write ranges of the threads never overlap
+        for (size_t i = min_idx; i < max_idx; i++) {
+            uint32_t value = src[i];
+            dst[offsets[(value >> shift) & MASK]++] = value;
+        }
 
+        // the next pass reads what every thread scattered and reuses the histograms
+        pthread_barrier_wait(&shared->barrier);
 
+        // rotate pointers from the sorting array to the sorted array
+        uint32_t *swap = src;
+        src = dst;
+        dst = swap;
+    }
 
-// Function to find the maximum value in an array
-int getMax(int arr[], int n) {
-    int max = arr[0];
-    for (int i = 1; i < n; i++) {
-        if (arr[i] > max)
-            max = arr[i];
+    // an odd number of scatter passes leaves the result in the scratch array
+    if (src != shared->arr) {
+        memcpy(shared->arr + min_idx, src + min_idx, (max_idx - min_idx) * sizeof(uint32_t));
     }
-    return max;
+
+    return NULL;
 }
 
-// Function to perform counting sort based on a specific digit represented by `exp`
-void countingSort(int arr[], int n, int exp) {
-    pthread_t threads[NUM_THREADS];
+// parallel radix sort with an explicit thread count
+void radix_sort_parallel(uint32_t *arr, size_t size, int num_threads) {
+    if (size < 2) {
+        return;
+    }
+    if (num_threads < 1) {
+        num_threads = 1;
+    }
+    if (num_threads > MAX_THREADS) {
+        num_threads = MAX_THREADS;
+    }
 
-    /*// Initialize shared resources
-    for (int i = 0; i < NUM_RESOURCES; i++) {
-        resources[i] = 0;
-    }*/
+    RadixShared shared;
+    shared.arr = arr;
+    shared.size = size;
+    shared.num_threads = num_threads;
 
-    // Initialize mutexes
-    for (int i = 0; i < NUM_LOCKS; i++) {
-        if (pthread_mutex_init(&locks[i], NULL) != 0) {
-            fprintf(stderr, "Failed to initialize mutex %d\n", i);
-            exit(EXIT_FAILURE);
-        }
+    // scratch array on huge pages, faulted in by the threads themselves
+    shared.sorting_arr = sort_alloc(size * sizeof(uint32_t), 0);
+    // cache line aligned rows so threads never share a histogram line
+    shared.counts = aligned_alloc(64, num_threads * sizeof(*shared.counts));
+    if (!shared.counts) {
+        perror("Failed to allocate memory");
+        exit(EXIT_FAILURE);
     }
 
-    int *output = (int *)malloc(n * sizeof(int)); // Output array
-    //int count[10] = {0}; // Initialize count array for base 10
-    int *count = (int *)malloc(10 * sizeof(int));
-    for (int i = 0; i < 10; i++)
-	    count[i] = 0;
-    // Count occurrences of each digit at the `exp` place
-    for (int i = 0; i < n; i++) {
-        int digit = (arr[i] / exp) % 10;
-        count[digit]++;
+    if (pthread_barrier_init(&shared.barrier, NULL, num_threads) != 0) {
+        fprintf(stderr, "Failed to initialize barrier\n");
+        exit(EXIT_FAILURE);
     }
 
-    // Update count[i] to store the position of the next digit in the output array
-    for (int i = 1; i < 10; i++) {
-        count[i] += count[i - 1];
-    }
+    pthread_t threads[MAX_THREADS];
+    ThreadArgs args[MAX_THREADS];
 
-    // Create threads
-    for (int i = 0; i < NUM_THREADS; i++) {
-	ThreadArgs* args = malloc(sizeof(ThreadArgs));
-	args->arr = arr;
-	args->exp = exp;
-	args->count = count;
-	args->output = output;
-	args->n = n;
-        /*int* thread_id = malloc(sizeof(int));
-        if (thread_id == NULL) {
-            fprintf(stderr, "Failed to allocate memory for thread ID\n");
-            exit(EXIT_FAILURE);
-        }*/
-        args->thread_id = i;
-        if (pthread_create(&threads[i], NULL, threadFunction, args) != 0) {
+    // the calling thread works as thread 0
+    for (int i = 1; i < num_threads; i++) {
+        args[i].shared = &shared;
+        args[i].thread_id = i;
+        if (pthread_create(&threads[i], NULL, threadFunction, &args[i]) != 0) {
             fprintf(stderr, "Failed to create thread %d\n", i);
             exit(EXIT_FAILURE);
         }
     }
+    args[0].shared = &shared;
+    args[0].thread_id = 0;
+    threadFunction(&args[0]);
 
-    // Wait for all threads to finish
-    for (int i = 0; i < NUM_THREADS; i++) {
+    // wait for all threads to finish
+    for (int i = 1; i < num_threads; i++) {
         pthread_join(threads[i], NULL);
     }
 
-    // Destroy mutexes
-    for (int i = 0; i < NUM_LOCKS; i++) {
-        pthread_mutex_destroy(&locks[i]);
-    }
-
-/*
-    // Build the output array
-    for (int i = n - 1; i >= 0; i--) {
-        int digit = (arr[i] / exp) % 10;
-        output[count[digit] - 1] = arr[i];
-        count[digit]--;
-    }
-*/
-    // Copy the output array back into the original array
-    for (int i = 0; i < n; i++) {
-        arr[i] = output[i];
-    }
-
-    free(output); // Free allocated memory
-    free(count);
-}
-
-// Function to perform Radix Sort
-void radixSort(int arr[], int n) {
-    int max = getMax(arr, n); // Find the maximum number to determine the number of digits
-
-    // Perform counting sort for each digit (1's place, 10's place, 100's place, etc.)
-    for (int exp = 1; max / exp > 0; exp *= 10) {
-        countingSort(arr, n, exp);
-    }
+    // every thread copied its chunk back if the result ended up in sorting_arr
+    pthread_barrier_destroy(&shared.barrier);
+    free(shared.counts);
+    sort_free(shared.sorting_arr, size * sizeof(uint32_t));
 }
 
-void sort_array(int *arr, size_t size) {
-// Enter your logic here
-        radixSort(arr, size);
-
+#ifndef LIBSORT
+// Avoid making changes to this function skeleton, apart from data type changes if required
+// In this starter code we have used uint32_t, feel free to change it to any other data type if required
+void sort_array(uint32_t *arr, size_t size) {
+    // use every online core
+    radix_sort_parallel(arr, size, (int)sysconf(_SC_NPROCESSORS_ONLN));
 }
 
 
-
 // Vanilla radix sort
-void radix_sort_vanilla(int *arr, size_t size) {
-    const int RADIX = 10;
-    int max_val = arr[0];
+void radix_sort_vanilla(uint32_t *arr, size_t size) {
+    const int RADIX10 = 10;
+    uint32_t max_val = arr[0];
     for (size_t i = 1; i < size; i++) {
         if (arr[i] > max_val) {
             max_val = arr[i];
         }
     }
 
-    int *output = malloc(size * sizeof(int));
+    uint32_t *output = malloc(size * sizeof(uint32_t));
     if (!output) {
         perror("Failed to allocate memory");
         exit(EXIT_FAILURE);
     }
 
-    for (int exp = 1; max_val / exp > 0; exp *= RADIX) {
-        int count[RADIX];
-	memset(count, 0, sizeof(count));
-
+    for (uint32_t exp = 1; max_val / exp > 0; exp *= RADIX10) {
+        size_t count[RADIX10];
+        memset(count, 0, sizeof(count));
 
         for (size_t i = 0; i < size; i++) {
-            count[(arr[i] / exp) % RADIX]++;
+            count[(arr[i] / exp) % RADIX10]++;
         }
 
-        for (int i = 1; i < RADIX; i++) {
+        for (int i = 1; i < RADIX10; i++) {
             count[i] += count[i - 1];
         }
 
-        for (int i = size - 1; i >= 0; i--) {
-            output[--count[(arr[i] / exp) % RADIX]] = arr[i];
+        for (size_t i = size; i-- > 0;) {
+            output[--count[(arr[i] / exp) % RADIX10]] = arr[i];
         }
 
         for (size_t i = 0; i < size; i++) {
             arr[i] = output[i];
         }
+
+        // stop before exp overflows for keys with 10 decimal digits
+        if (exp > UINT32_MAX / RADIX10) {
+            break;
+        }
     }
 
     free(output);
 }
 
-void sort_array_vanilla(int *arr, size_t size) {
+void sort_array_vanilla(uint32_t *arr, size_t size) {
     radix_sort_vanilla(arr, size);
 }
 
-int main() {
-//Initialise the array
+int main(int argc, char *argv[]) {
+    // optional array size as a power of two and thread count
+    int power = (argc > 1) ? atoi(argv[1]) : 22;
+    int num_threads = (argc > 2) ? atoi(argv[2]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    size_t size = (size_t)1 << power;
 
-    size_t size = 1 << 22; // Example: Allocate space for 2^15 elements (~128KB for uint32_t)
-    int *arr = malloc(size * sizeof(int)); // Allocate memory for the array
-    int *arr_copy = malloc(size * sizeof(int)); // Copy of the array for comparison
-    if (!arr || !arr_copy) {
+    // every thread reads all of the input, its pages are spread over the nodes
+    uint32_t *arr = sort_alloc(size * sizeof(uint32_t), SORT_ALLOC_INTERLEAVE | SORT_ALLOC_PREFAULT);
+    uint32_t *arr_copy = malloc(size * sizeof(uint32_t)); // Copy of the array for comparison
+    if (!arr_copy) {
         perror("Failed to allocate memory");
         exit(EXIT_FAILURE);
     }
 
+    // filled on num_threads threads, the first touch of each page on the thread that reads it most
+    data_fill_u32(arr, size, data_spec_of(DATA_UNIFORM), (uint64_t)time(NULL), num_threads);
+    memcpy(arr_copy, arr, size * sizeof(uint32_t)); // Keep a copy for vanilla sorting
+    data_checksum checksum = data_checksum_u32(arr, size, num_threads);
 
-	srand((unsigned)time(NULL)); // Seed the random number generator
+    uint64_t start, end, parallel_time, vanilla_time;
+    start = rdtsc_start();
+    radix_sort_parallel(arr, size, num_threads);
+    end = rdtsc_stop();
+    parallel_time = end - start;
 
-    for (size_t i = 0; i < size; i++) {
-        arr[i] = rand();
-        arr_copy[i] = arr[i]; // Keep a copy for vanilla sorting
-    }
-	uint64_t start, end, simd_time, vanilla_time;
-        start = rdtsc();
-    	sort_array(arr, size);
-    	end = rdtsc();
-    	simd_time = end - start;
-	for (int i = 0; i < 20; i++) {
-		printf("val = %d\n", arr[i]);
-	}
-    start = rdtsc();
+    start = rdtsc_start();
     sort_array_vanilla(arr_copy, size);
-    end = rdtsc();
+    end = rdtsc_stop();
     vanilla_time = end - start;
 
     // Compare results
     printf("\nSorting complete.\n");
-    printf("SIMD sort time: %lu cycles\n", simd_time);
-    printf("Vanilla sort time: %lu cycles\n", vanilla_time);
-    printf("Percentage speedup: %.2f%%\n", ((double)(vanilla_time - simd_time) / vanilla_time) * 100);
+    printf("Parallel sort time (%d threads): " TIMING_FMT "\n", num_threads, TIMING_ARGS(parallel_time, size));
+    printf("Vanilla sort time: " TIMING_FMT "\n", TIMING_ARGS(vanilla_time, size));
+    printf("Percentage speedup: %.2f%%\n", ((double)vanilla_time - parallel_time) / vanilla_time * 100);
 
     // Validate sorting correctness
-    for (size_t i = 1; i < size; i++) {
-        if (arr[i - 1] > arr[i] || arr_copy[i - 1] > arr_copy[i]) {
-            printf("Sorting failed.\n");
-            free(arr);
-            free(arr_copy);
-            return 1;
-        }
+    if (!data_verify_u32(arr, size, checksum, num_threads) || !data_verify_u32(arr_copy, size, checksum, num_threads)) {
+        printf("Sorting failed.\n");
+        sort_free(arr, size * sizeof(uint32_t));
+        free(arr_copy);
+        return 1;
     }
     printf("Both sorts validated successfully.\n");
 
-
-
-	free(arr);
-	free(arr_copy);
-// Print the sorted array
-return 0;
+    sort_free(arr, size * sizeof(uint32_t));
+    free(arr_copy);
+    return 0;
 }
-
+#endif
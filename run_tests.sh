@@ -1,19 +1,23 @@
 #!/bin/bash
 
-# Compile both programs
-gcc -O3 -mavx2 -o radix_sort_simd radix_sorting_simd.c
-gcc -O3 -o radix_sort_vanilla radix_sorting_vanilla.c
+# Build libsort and the benchmark driver, then sweep every engine over the
+# key distributions (see sort_bench.c), the results go to bench_results.csv
+# in the schema plot_bench.py, plot_radix_results.py and plot_merge_results.py
+# read, the time and hardware counters of every radix pass / merge level to
+# bench_phases.csv
+# ./run_tests.sh [baseline.csv] also reports the configurations that got slower
+set -e
 
-# Create CSV files with headers
-echo "power,size,cycles" > simd_results.csv
-echo "power,size,cycles" > vanilla_results.csv
+./build_libsort.sh
+# linked against the static archive, so it runs without LD_LIBRARY_PATH
+gcc -O3 -pthread -o sort_bench sort_bench.c libsort.a -lm
 
-# Test sizes from 2^20 to 2^30, incrementing by 2
-for power in {20..30..2}; do
-    echo "Testing size 2^$power"
-    # Run 10 times for each size
-    for run in {1..10}; do
-        ./radix_sort_simd $power >> simd_results.csv
-        ./radix_sort_vanilla $power >> vanilla_results.csv
-    done
-done
+# sizes 2^20 to 2^30 by 2, 10 timed runs after 2 warm-up runs, fixed seed
+# (2^30 keys take 8 GB, the input and the copy every run sorts)
+./sort_bench -p 20:30:2 -r 10 -w 2 -S 1 \
+    -e radix_vanilla,radix_simd,radix_simd_wc,radix_parallel,radix_msd,msd_parallel,merge_tiled,merge_parallel,merge_runs,counting,sort_array \
+    -o bench_results.csv -P bench_phases.csv
+
+python3 plot_bench.py bench_results.csv "$@"
+python3 plot_radix_results.py
+python3 plot_merge_results.py
@@ -7,6 +7,7 @@
 #include <cuda.h>
 #include <stdint.h>
 #include <time.h>
+#include "sort_timing.h"
 
 
 #define THREADS_PER_BLOCK 1024
@@ -234,12 +235,6 @@ bool is_sorted(int32_t* array, int size) {
     return true;
 }
 
-static inline uint64_t rdtsc() {
-    unsigned long a, d;
-    asm volatile ("rdtsc" : "=a" (a), "=d" (d));
-    return a | ((uint64_t)d<<32);
-}
-
 // Host function to perform parallel sorting and merging
 void sort_array(int32_t* h_array, int n) {
     int32_t *d_array, *d_temp;
@@ -304,7 +299,7 @@ void sort_array(int32_t* h_array, int n) {
 }
 
 int main() {
-    uint64_t start , end, start1, end1;
+    uint64_t start, end;
     int n = 1 << 30; 
     int32_t *sorted_array = (int32_t*)malloc(n * sizeof(int32_t));
 
@@ -313,21 +308,17 @@ int main() {
     printf("Original Array:\n");
     print_array(sorted_array, 16); // Print first 16 elements
 
-    // start clock
-    start = rdtsc();
-
-    start1 = clock();
+    // start clock, the wall time of the whole sort (clock() would only count the
+    // host's CPU time and miss the time spent waiting for the device)
+    start = rdtsc_start();
 
     // sort array
     sort_array(sorted_array, n);
 
     // end clock
-    end1 = clock();
-    end = rdtsc();
-
+    end = rdtsc_stop();
 
-    printf("The GPU mergesort took this many ticks: %llu \n", end - start);
-    printf("The GPU mergesort took this many seconds: %f \n", (double)(end1 - start1) / CLOCKS_PER_SEC);
+    printf("The GPU mergesort took: " TIMING_FMT "\n", TIMING_ARGS(end - start, n));
 
     printf("Sorted Array:\n");
     print_array(sorted_array, 16); // Print first 16 elements
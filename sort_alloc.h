@@ -0,0 +1,202 @@
+#ifndef SORT_ALLOC_H
+#define SORT_ALLOC_H
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+/* Allocator of the large key and scratch arrays
+ * a 4 KB page array of 2^30 keys is a million page faults on first touch and a
+ * scatter over it misses the TLB on almost every store, so arrays of at least
+ * SORT_ALLOC_MIN bytes are mapped on huge pages:
+ *   1 GB hugetlbfs pages for arrays of SORT_GIGA_MIN or more, 2 MB hugetlbfs
+ *   pages otherwise (both only when the administrator reserved them,
+ *   vm.nr_hugepages / hugepages-1048576kB), and else 2 MB aligned anonymous
+ *   memory with MADV_HUGEPAGE (transparent huge pages)
+ * SORT_ALLOC_PREFAULT touches every page before returning, so the faults are
+ * taken here and not in the first pass of the sort
+ * SORT_ALLOC_INTERLEAVE spreads the pages over every NUMA node (mbind), for
+ * arrays every thread reads and writes all over (the input of the parallel
+ * sorts, the scatter target), sort_prefault_range lets each thread first-touch
+ * its own chunk instead, which puts the chunk on that thread's node
+ * smaller arrays (and every array with -DSORT_ALLOC_HUGE=0, for comparison)
+ * come from malloc, sort_free takes the size the array was allocated with
+ * allocation failures exit like every malloc in this repo
+ */
+
+#ifndef SORT_ALLOC_HUGE
+#define SORT_ALLOC_HUGE 1
+#endif
+
+#define SORT_ALLOC_PREFAULT 1
+#define SORT_ALLOC_INTERLEAVE 2
+
+#define SORT_ALLOC_MIN ((size_t)2 << 20)   // smallest array worth a huge page mapping
+#define SORT_HUGE_2M ((size_t)2 << 20)
+#define SORT_HUGE_1G ((size_t)1 << 30)
+#define SORT_GIGA_MIN ((size_t)4 << 30)    // smallest array tried on 1 GB pages
+#define SORT_PAGE 4096
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#define SORT_MAP_HUGE_1G (30 << MAP_HUGE_SHIFT)
+#define SORT_MPOL_INTERLEAVE 3
+
+// where the mapping behind an array starts and how long it is, stored in the
+// 64 bytes after the array (the array itself stays huge page aligned)
+typedef struct {
+    void *base;
+    size_t length;
+} sort_mapping;
+
+static inline size_t sort_round_up(size_t bytes, size_t unit) {
+    return (bytes + unit - 1) / unit * unit;
+}
+
+// write every page of [p, p + bytes) once, on the calling thread
+static inline void sort_prefault_range(void *p, size_t bytes) {
+    volatile char *bytes_p = (volatile char *)p;
+    for (size_t i = 0; i < bytes; i += SORT_PAGE) {
+        bytes_p[i] = 0;
+    }
+}
+
+// mask of the online NUMA nodes (the first 64), 1 on machines without NUMA
+static inline unsigned long sort_numa_nodes(void) {
+    FILE *file = fopen("/sys/devices/system/node/online", "r");
+    unsigned long mask = 0;
+    if (!file) {
+        return 1;
+    }
+    // a list of ranges, "0" or "0-3" or "0,2-3"
+    int first, last;
+    char separator;
+    while (fscanf(file, "%d", &first) == 1) {
+        last = first;
+        if (fscanf(file, "%c", &separator) == 1 && separator == '-') {
+            if (fscanf(file, "%d", &last) != 1) {
+                break;
+            }
+            if (fscanf(file, "%c", &separator) != 1) {
+                separator = '\n';
+            }
+        }
+        for (int node = first; node <= last && node < 64; node++) {
+            mask |= 1ul << node;
+        }
+        if (separator != ',') {
+            break;
+        }
+    }
+    fclose(file);
+    return mask ? mask : 1;
+}
+
+// spread the pages of a fresh mapping over every node, before anything touches it
+static inline void sort_interleave(void *p, size_t length) {
+    unsigned long nodes = sort_numa_nodes();
+    if (nodes & (nodes - 1)) {
+        // more than one node, a failure leaves the default first touch policy
+        syscall(SYS_mbind, p, length, SORT_MPOL_INTERLEAVE, &nodes, 64, 0);
+    }
+}
+
+// mapping of length bytes aligned to align, hugetlb_flags the MAP_HUGETLB flags
+// of a hugetlbfs mapping or 0 for transparent huge pages
+static inline void *sort_map(size_t length, size_t align, int hugetlb_flags, sort_mapping *mapping) {
+    if (hugetlb_flags) {
+        void *p = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | hugetlb_flags, -1, 0);
+        if (p == MAP_FAILED) {
+            return NULL;
+        }
+        mapping->base = p;
+        mapping->length = length;
+        return p;
+    }
+
+    // over allocate by one huge page and cut the mapping down to an aligned one
+    char *raw = mmap(NULL, length + align, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+        return NULL;
+    }
+    char *p = (char *)sort_round_up((uintptr_t)raw, align);
+    if (p > raw) {
+        munmap(raw, p - raw);
+    }
+    if (raw + align > p) {
+        munmap(p + length, raw + align - p);
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(p, length, MADV_HUGEPAGE);
+#endif
+    mapping->base = p;
+    mapping->length = length;
+    return p;
+}
+
+// bytes of memory for a key or scratch array, flags SORT_ALLOC_*
+static inline void *sort_alloc(size_t bytes, int flags) {
+    if (!SORT_ALLOC_HUGE || bytes < SORT_ALLOC_MIN) {
+        void *p = malloc(bytes);
+        if (!p) {
+            perror("Failed to allocate memory");
+            exit(EXIT_FAILURE);
+        }
+        if (flags & SORT_ALLOC_PREFAULT) {
+            sort_prefault_range(p, bytes);
+        }
+        return p;
+    }
+
+    // room for the mapping record after the array
+    size_t needed = sort_round_up(bytes, 64) + sizeof(sort_mapping);
+    sort_mapping mapping;
+    void *p = NULL;
+    if (bytes >= SORT_GIGA_MIN) {
+        p = sort_map(sort_round_up(needed, SORT_HUGE_1G), SORT_HUGE_1G, MAP_HUGETLB | SORT_MAP_HUGE_1G, &mapping);
+    }
+    if (!p) {
+        p = sort_map(sort_round_up(needed, SORT_HUGE_2M), SORT_HUGE_2M, MAP_HUGETLB, &mapping);
+    }
+    if (!p) {
+        p = sort_map(sort_round_up(needed, SORT_HUGE_2M), SORT_HUGE_2M, 0, &mapping);
+    }
+    if (!p) {
+        perror("Failed to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+
+    if (flags & SORT_ALLOC_INTERLEAVE) {
+        sort_interleave(mapping.base, mapping.length);
+    }
+    memcpy((char *)p + sort_round_up(bytes, 64), &mapping, sizeof(mapping));
+    if (flags & SORT_ALLOC_PREFAULT) {
+        sort_prefault_range(p, bytes);
+    }
+    return p;
+}
+
+// release an array of sort_alloc, bytes as passed to sort_alloc
+static inline void sort_free(void *p, size_t bytes) {
+    if (!p) {
+        return;
+    }
+    if (!SORT_ALLOC_HUGE || bytes < SORT_ALLOC_MIN) {
+        free(p);
+        return;
+    }
+    sort_mapping mapping;
+    memcpy(&mapping, (char *)p + sort_round_up(bytes, 64), sizeof(mapping));
+    munmap(mapping.base, mapping.length);
+}
+
+#endif
@@ -0,0 +1,411 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "sort_timing.h"
+#include "sort_alloc.h"
+#include "sort_data.h"
+#include "libsort.h"
+
+/* Benchmark driver for every engine of libsort
+ * sweeps sizes, key distributions and thread counts, every configuration sorts
+ * the same keys (fixed seed per size and distribution) after warm-up runs, and
+ * the repetitions are reduced to median and 95th percentile cycles and
+ * nanoseconds, ns per key and GB/s of keys sorted, every result is checked
+ * (sorted and the same multiset checksum as the input)
+ * distributions (sort_data.h, generated and checked on every core):
+ * uniform (full 32 bit keys), few_unique (16 distinct keys), sorted, reverse,
+ * zipf (DATA_ZIPF_KEYS keys, exponent 1, the frequent keys are scattered over
+ * the key space)
+ * engines: every libsort engine by name (libsort_engine_name) and sort_array
+ * (the dispatcher), engines without threads run once with threads 1
+ * output, one row / object per configuration (plot_bench.py reads both):
+ *   engine,distribution,threads,power,size,reps,cycles_median,cycles_p95,
+ *   ns_median,ns_p95,cycles_per_key,ns_per_key,gb_per_s,keys_per_s
+ * cycles are fenced TSC reads (sort_timing.h), ns the CLOCK_MONOTONIC_RAW time
+ * of the same runs
+ * -P file adds the per phase breakdown of the engines with phase hooks
+ * (perf_counters.h) in the same format, per run averages of reps more runs
+ * after the timed ones, the counters are only open for those:
+ *   engine,distribution,threads,power,phase,level,calls,tsc_cycles,share,
+ *   cycles,instructions,ipc,llc_misses,dtlb_misses,branch_misses
+ * share is the phase's part of the median timed run, events the machine
+ * can't count are left empty (null in json), the timed runs never read the
+ * counters
+ * COMPILE: ./build_libsort.sh && gcc -O3 -pthread sort_bench.c -L. -lsort -lm -o sort_bench
+ * RUN: ./sort_bench [-p first:last[:step]] [-e engines] [-d distributions]
+ *                   [-t threads] [-r reps] [-w warmups] [-S seed] [-f csv|json] [-o file]
+ *                   [-P phase file]
+ * lists are comma separated, defaults: -p 16:24:2, every engine but
+ * radix_vanilla, every distribution, -t 1,<cores>, -r 5, -w 1, -S 1, csv to stdout
+ */
+
+#define MAX_LIST 32
+#define AUTO_ENGINE LIBSORT_NUM_ENGINES // sort_array
+
+// summary of the repetitions of one configuration
+typedef struct {
+    uint64_t cycles_median, cycles_p95;
+    double ns_median, ns_p95;
+} bench_stats;
+
+static const char *engine_label(int engine) {
+    return engine == AUTO_ENGINE ? "sort_array" : libsort_engine_name((libsort_engine)engine);
+}
+
+// engines that take a thread count, the others run once per size
+static int engine_threaded(int engine) {
+    return engine == AUTO_ENGINE || engine == LIBSORT_RADIX_PARALLEL || engine == LIBSORT_MSD_PARALLEL ||
+           engine == LIBSORT_MERGE_PARALLEL || engine == LIBSORT_COUNTING;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// sort work with the engine (or the dispatcher)
+static void run_engine(int engine, int threads, uint32_t *work, size_t size) {
+    if (engine == AUTO_ENGINE) {
+        libsort_sort(work, size, threads);
+    } else {
+        libsort_sort_with((libsort_engine)engine, work, size, threads);
+    }
+}
+
+// sort a copy of input reps times after warmups untimed runs
+static bench_stats run_config(int engine, int threads, const uint32_t *input, uint32_t *work,
+                              size_t size, int reps, int warmups) {
+    uint64_t *cycles = malloc(reps * sizeof(uint64_t));
+    double *ns = malloc(reps * sizeof(double));
+    if (!cycles || !ns) {
+        perror("Failed to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+    data_checksum expected = data_checksum_u32(input, size, 0);
+
+    for (int r = -warmups; r < reps; r++) {
+        memcpy(work, input, size * sizeof(uint32_t));
+
+        uint64_t start_ns = monotonic_raw_ns();
+        uint64_t start = rdtsc_start();
+        run_engine(engine, threads, work, size);
+        uint64_t end = rdtsc_stop();
+        uint64_t end_ns = monotonic_raw_ns();
+
+        if (!data_verify_u32(work, size, expected, 0)) {
+            fprintf(stderr, "%s sorting failed (%zu keys, %d threads)\n", engine_label(engine), size, threads);
+            exit(EXIT_FAILURE);
+        }
+        if (r >= 0) {
+            cycles[r] = end - start;
+            ns[r] = (double)(end_ns - start_ns);
+        }
+    }
+
+    // median (mean of the middle two for even counts) and nearest rank p95
+    qsort(cycles, reps, sizeof(uint64_t), compare_u64);
+    qsort(ns, reps, sizeof(double), compare_double);
+    int p95 = (int)ceil(0.95 * reps) - 1;
+    bench_stats stats;
+    stats.cycles_median = (cycles[(reps - 1) / 2] + cycles[reps / 2]) / 2;
+    stats.cycles_p95 = cycles[p95];
+    stats.ns_median = (ns[(reps - 1) / 2] + ns[reps / 2]) / 2;
+    stats.ns_p95 = ns[p95];
+
+    free(ns);
+    free(cycles);
+    return stats;
+}
+
+// reps runs of a configuration with the counters open, for its phase table
+// (the hooks read the counters twice per phase, so these runs are never timed)
+static void run_phases(int engine, int threads, const uint32_t *input, uint32_t *work, size_t size, int reps) {
+    perf_open();
+    for (int r = 0; r < reps; r++) {
+        memcpy(work, input, size * sizeof(uint32_t));
+        run_engine(engine, threads, work, size);
+    }
+}
+
+// comma separated list of ints
+static int parse_ints(const char *text, int *values) {
+    int count = 0;
+    char *copy = strdup(text);
+    for (char *item = strtok(copy, ","); item && count < MAX_LIST; item = strtok(NULL, ",")) {
+        values[count++] = atoi(item);
+    }
+    free(copy);
+    return count;
+}
+
+// comma separated list of names, -1 for a name that isn't known
+static int parse_names(const char *text, int *values, const char *(*name_of)(int), int known) {
+    int count = 0;
+    char *copy = strdup(text);
+    for (char *item = strtok(copy, ","); item && count < MAX_LIST; item = strtok(NULL, ",")) {
+        int found = -1;
+        for (int v = 0; v < known; v++) {
+            if (strcmp(item, name_of(v)) == 0) {
+                found = v;
+            }
+        }
+        if (found < 0) {
+            fprintf(stderr, "unknown name %s\n", item);
+            exit(EXIT_FAILURE);
+        }
+        values[count++] = found;
+    }
+    free(copy);
+    return count;
+}
+
+// one counter of a phase row, per run, empty / null when the event didn't open
+static void print_count(FILE *out, uint64_t count, int reps, int json) {
+    if (count == PERF_MISSING) {
+        if (json) {
+            fprintf(out, "null");
+        }
+    } else {
+        fprintf(out, "%.0f", (double)count / reps);
+    }
+}
+
+// the phase table of the last configuration, rows counts the rows written so far
+static int print_phases(FILE *out, int json, int rows, const char *engine, const char *dist,
+                        int threads, int power, int reps, uint64_t cycles_median) {
+    const perf_phase *phases;
+    size_t num_phases = perf_phases(&phases);
+
+    for (size_t p = 0; p < num_phases; p++) {
+        const perf_phase *phase = &phases[p];
+        double tsc = (double)phase->tsc / reps;
+        double share = cycles_median ? tsc / cycles_median : 0;
+        int has_ipc = phase->count[PERF_CYCLES] != PERF_MISSING && phase->count[PERF_CYCLES] > 0 &&
+                      phase->count[PERF_INSTRUCTIONS] != PERF_MISSING;
+        double ipc = has_ipc ? (double)phase->count[PERF_INSTRUCTIONS] / phase->count[PERF_CYCLES] : 0;
+
+        if (json) {
+            fprintf(out, "%s  {\"engine\": \"%s\", \"distribution\": \"%s\", \"threads\": %d, "
+                         "\"power\": %d, \"phase\": \"%s\", \"level\": %d, \"calls\": %.0f, "
+                         "\"tsc_cycles\": %.0f, \"share\": %.4f",
+                    rows > 0 ? ",\n" : "", engine, dist, threads, power, phase->name, phase->level,
+                    (double)phase->calls / reps, tsc, share);
+            for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+                fprintf(out, ", \"%s\": ", perf_event_name((perf_event)e));
+                print_count(out, phase->count[e], reps, json);
+                if (e == PERF_INSTRUCTIONS) {
+                    fprintf(out, has_ipc ? ", \"ipc\": %.3f" : ", \"ipc\": null", ipc);
+                }
+            }
+            fprintf(out, "}");
+        } else {
+            fprintf(out, "%s,%s,%d,%d,%s,%d,%.0f,%.0f,%.4f", engine, dist, threads, power, phase->name,
+                    phase->level, (double)phase->calls / reps, tsc, share);
+            for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+                fprintf(out, ",");
+                print_count(out, phase->count[e], reps, json);
+                if (e == PERF_INSTRUCTIONS) {
+                    fprintf(out, has_ipc ? ",%.3f" : ",", ipc);
+                }
+            }
+            fprintf(out, "\n");
+        }
+        rows++;
+    }
+    fflush(out);
+    return rows;
+}
+
+int main(int argc, char *argv[]) {
+    int first_power = 16, last_power = 24, step = 2;
+    int engines[MAX_LIST], num_engines = 0;
+    int dists[MAX_LIST], num_dists = 0;
+    int threads[MAX_LIST], num_threads = 0;
+    int reps = 5, warmups = 1;
+    uint64_t seed = 1;
+    int json = 0;
+    FILE *out = stdout;
+    FILE *phase_out = NULL;
+    int option;
+
+    while ((option = getopt(argc, argv, "p:e:d:t:r:w:S:f:o:P:")) != -1) {
+        switch (option) {
+        case 'p':
+            if (sscanf(optarg, "%d:%d:%d", &first_power, &last_power, &step) < 2) {
+                first_power = last_power = atoi(optarg);
+            }
+            break;
+        case 'e':
+            num_engines = parse_names(optarg, engines, engine_label, LIBSORT_NUM_ENGINES + 1);
+            break;
+        case 'd':
+            num_dists = parse_names(optarg, dists, data_dist_name, DATA_NUM_DISTS);
+            break;
+        case 't':
+            num_threads = parse_ints(optarg, threads);
+            break;
+        case 'r':
+            reps = atoi(optarg);
+            break;
+        case 'w':
+            warmups = atoi(optarg);
+            break;
+        case 'S':
+            seed = strtoull(optarg, NULL, 0);
+            break;
+        case 'f':
+            json = strcmp(optarg, "json") == 0;
+            break;
+        case 'o':
+            out = fopen(optarg, "w");
+            if (!out) {
+                perror("Failed to open output file");
+                return 1;
+            }
+            break;
+        case 'P':
+            phase_out = fopen(optarg, "w");
+            if (!phase_out) {
+                perror("Failed to open phase file");
+                return 1;
+            }
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-p first:last[:step]] [-e engines] [-d distributions] "
+                            "[-t threads] [-r reps] [-w warmups] [-S seed] [-f csv|json] [-o file] "
+                            "[-P phase file]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (num_engines == 0) {
+        for (int e = 0; e <= LIBSORT_NUM_ENGINES; e++) {
+            if (e != LIBSORT_RADIX_VANILLA) {
+                engines[num_engines++] = e;
+            }
+        }
+    }
+    if (num_dists == 0) {
+        for (int d = 0; d < DATA_NUM_DISTS; d++) {
+            dists[num_dists++] = d;
+        }
+    }
+    if (num_threads == 0) {
+        int cores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        threads[num_threads++] = 1;
+        if (cores > 1) {
+            threads[num_threads++] = cores;
+        }
+    }
+    reps = reps < 1 ? 1 : reps;
+    warmups = warmups < 0 ? 0 : warmups;
+    step = step < 1 ? 1 : step;
+
+    size_t max_size = (size_t)1 << last_power;
+    uint32_t *input = sort_alloc(max_size * sizeof(uint32_t), SORT_ALLOC_PREFAULT);
+    uint32_t *work = sort_alloc(max_size * sizeof(uint32_t), SORT_ALLOC_PREFAULT);
+
+    if (json) {
+        fprintf(out, "[\n");
+    } else {
+        fprintf(out, "engine,distribution,threads,power,size,reps,cycles_median,cycles_p95,"
+                     "ns_median,ns_p95,cycles_per_key,ns_per_key,gb_per_s,keys_per_s\n");
+    }
+
+    int phase_rows = 0;
+    if (phase_out) {
+        // the hooks only count the thread that opened the counters, this one
+        int opened = perf_open();
+        perf_close();
+        if (opened < PERF_NUM_EVENTS) {
+            fprintf(stderr, "%d of %d hardware events available, phases are timed with the TSC\n",
+                    opened, PERF_NUM_EVENTS);
+        }
+        if (json) {
+            fprintf(phase_out, "[\n");
+        } else {
+            fprintf(phase_out, "engine,distribution,threads,power,phase,level,calls,tsc_cycles,share,"
+                               "cycles,instructions,ipc,llc_misses,dtlb_misses,branch_misses\n");
+        }
+    }
+
+    int rows = 0;
+    for (int power = first_power; power <= last_power; power += step) {
+        size_t size = (size_t)1 << power;
+        for (int d = 0; d < num_dists; d++) {
+            // the keys depend only on the seed, the size and the distribution
+            data_fill_u32(input, size, data_spec_of((data_dist)dists[d]), seed ^ ((uint64_t)power << 48), 0);
+
+            for (int e = 0; e < num_engines; e++) {
+                for (int t = 0; t < num_threads; t++) {
+                    int engine_threads = threads[t];
+                    if (!engine_threaded(engines[e])) {
+                        if (t > 0) {
+                            continue;
+                        }
+                        engine_threads = 1;
+                    }
+
+                    bench_stats stats = run_config(engines[e], engine_threads, input, work, size, reps, warmups);
+                    double cycles_per_key = (double)stats.cycles_median / size;
+                    double ns_per_key = stats.ns_median / size;
+                    double gb_per_s = size * sizeof(uint32_t) / stats.ns_median;
+                    double keys_per_s = size / stats.ns_median * 1e9;
+
+                    if (json) {
+                        fprintf(out, "%s  {\"engine\": \"%s\", \"distribution\": \"%s\", \"threads\": %d, "
+                                     "\"power\": %d, \"size\": %zu, \"reps\": %d, "
+                                     "\"cycles_median\": %lu, \"cycles_p95\": %lu, "
+                                     "\"ns_median\": %.0f, \"ns_p95\": %.0f, \"cycles_per_key\": %.3f, "
+                                     "\"ns_per_key\": %.3f, \"gb_per_s\": %.3f, \"keys_per_s\": %.0f}",
+                                rows > 0 ? ",\n" : "", engine_label(engines[e]), data_dist_name(dists[d]),
+                                engine_threads, power, size, reps, stats.cycles_median, stats.cycles_p95,
+                                stats.ns_median, stats.ns_p95, cycles_per_key, ns_per_key, gb_per_s,
+                                keys_per_s);
+                    } else {
+                        fprintf(out, "%s,%s,%d,%d,%zu,%d,%lu,%lu,%.0f,%.0f,%.3f,%.3f,%.3f,%.0f\n",
+                                engine_label(engines[e]), data_dist_name(dists[d]), engine_threads, power, size,
+                                reps, stats.cycles_median, stats.cycles_p95, stats.ns_median, stats.ns_p95,
+                                cycles_per_key, ns_per_key, gb_per_s, keys_per_s);
+                    }
+                    fflush(out);
+                    rows++;
+
+                    if (phase_out) {
+                        run_phases(engines[e], engine_threads, input, work, size, reps);
+                        phase_rows = print_phases(phase_out, json, phase_rows, engine_label(engines[e]),
+                                                  data_dist_name(dists[d]), engine_threads, power, reps,
+                                                  stats.cycles_median);
+                        perf_close();
+                    }
+                }
+            }
+        }
+    }
+
+    if (json) {
+        fprintf(out, "\n]\n");
+    }
+    if (out != stdout) {
+        fclose(out);
+    }
+    if (phase_out) {
+        if (json) {
+            fprintf(phase_out, "\n]\n");
+        }
+        fclose(phase_out);
+    }
+    sort_free(work, max_size * sizeof(uint32_t));
+    sort_free(input, max_size * sizeof(uint32_t));
+    return 0;
+}
@@ -0,0 +1,446 @@
+#ifndef SORT_DATA_H
+#define SORT_DATA_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <immintrin.h>
+
+/* Input keys and result checks of the benchmark mains
+ * rand() is serial (a lock around one state) and gives 31 bits, the fill of
+ * a large input took longer than a parallel sort of it and the top bit of every
+ * key was 0, so
+ * the keys come from a counter based generator instead: key i is a hash
+ * (splitmix64) of the seed and i, every thread fills its own range and the
+ * keys don't depend on the thread count
+ *   data_fill_u32 / data_fill_u64   keys of a distribution (data_spec):
+ *     uniform      every bit random, or uniform in [0, range)
+ *     few_unique   distinct keys, picked at random
+ *     sorted       non-decreasing over the whole key space, random steps
+ *     reverse      the sorted keys backwards
+ *     zipf         rank r of distinct keys drawn with probability ~ 1 / r^exponent,
+ *                  the frequent keys scattered over the key space
+ *   data_checksum_u32 / _u64        multiset checksum of the keys: two sums of a
+ *                                   mixed hash of every key, the same for every
+ *                                   order of the same keys
+ *   data_verify_u32 / _u64          1 if the keys are sorted and have the checksum
+ *                                   the input had (the output is a permutation of
+ *                                   the input, not just ordered), one parallel read
+ *   data_scan_keys                  both of a block at once, for keys streamed from a
+ *                                   file (data_checksum_add sums the blocks)
+ * the u32 scan compares 8 neighbours and hashes 8 keys per AVX2 step when the CPU
+ * has AVX2 (picked at runtime, the files still build without -mavx2)
+ * num_threads <= 0 uses every core
+ */
+
+#define DATA_FEW_UNIQUE_KEYS 16 // default distinct keys of few_unique
+#define DATA_ZIPF_KEYS (1 << 16) // default distinct keys of zipf
+#define DATA_CHUNK (1 << 16)    // fewest keys per thread
+#define DATA_MAX_THREADS 256
+#define DATA_LN2 0.69314718055994530942
+
+typedef enum {
+    DATA_UNIFORM,
+    DATA_FEW_UNIQUE,
+    DATA_SORTED,
+    DATA_REVERSE,
+    DATA_ZIPF,
+    DATA_NUM_DISTS
+} data_dist;
+
+// a distribution and its parameters, 0 picks the default
+typedef struct {
+    data_dist dist;
+    uint64_t range;     // uniform: keys in [0, range), 0: every key of the width
+    uint32_t distinct;  // few_unique / zipf: distinct keys
+    double exponent;    // zipf: 1.0 by default
+} data_spec;
+
+typedef struct {
+    uint64_t sum[2];
+} data_checksum;
+
+static inline const char *data_dist_name(int dist) {
+    static const char *names[DATA_NUM_DISTS] = {"uniform", "few_unique", "sorted", "reverse", "zipf"};
+    return (dist >= 0 && dist < DATA_NUM_DISTS) ? names[dist] : "unknown";
+}
+
+static inline data_spec data_spec_of(data_dist dist) {
+    data_spec spec = { dist, 0, 0, 0 };
+    return spec;
+}
+
+// the random 64 bits at position counter of the stream seed
+static inline uint64_t data_random(uint64_t seed, uint64_t counter) {
+    uint64_t z = seed + (counter + 1) * 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// murmur3 finalizer, the key hash of the checksums (vectorizes with 32 bit lanes)
+static inline uint32_t data_mix32(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return h;
+}
+
+#define DATA_SALT0 0x9E3779B9u
+#define DATA_SALT1 0x7F4A7C15u
+
+static inline int data_threads(int num_threads, size_t size) {
+    if (num_threads <= 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        num_threads = cores > 0 ? (int)cores : 1;
+    }
+    size_t most = size / DATA_CHUNK;
+    if ((size_t)num_threads > most) {
+        num_threads = most > 0 ? (int)most : 1;
+    }
+    return num_threads < DATA_MAX_THREADS ? num_threads : DATA_MAX_THREADS;
+}
+
+// one range of a parallel fill or scan
+typedef struct {
+    void (*work)(void *context, size_t lo, size_t hi, int part);
+    void *context;
+    size_t lo, hi;
+    int part;
+} data_range;
+
+static inline void *data_range_thread(void *arg) {
+    data_range *range = (data_range *)arg;
+    range->work(range->context, range->lo, range->hi, range->part);
+    return NULL;
+}
+
+// split [0, size) into parts ranges, the calling thread takes the first one
+static inline void data_parallel(size_t size, int parts, void (*work)(void *, size_t, size_t, int), void *context) {
+    pthread_t threads[DATA_MAX_THREADS];
+    data_range ranges[DATA_MAX_THREADS];
+    if (parts < 1) {
+        parts = 1;
+    }
+    for (int p = 0; p < parts; p++) {
+        data_range range = { work, context, size * p / parts, size * (p + 1) / parts, p };
+        ranges[p] = range;
+    }
+    int started = 1;
+    for (; started < parts; started++) {
+        if (pthread_create(&threads[started], NULL, data_range_thread, &ranges[started]) != 0) {
+            break;
+        }
+    }
+    // ranges without a thread run here
+    for (int p = started; p < parts; p++) {
+        data_range_thread(&ranges[p]);
+    }
+    data_range_thread(&ranges[0]);
+    for (int p = 1; p < started; p++) {
+        pthread_join(threads[p], NULL);
+    }
+}
+
+// x^-s for x >= 1 without libm (the mains build with a bare gcc line):
+// log2 x from the exponent and the atanh series of the mantissa, 2^y by its
+// integer part and the series of e^(fraction * ln 2)
+static inline double data_pow_neg(double x, double s) {
+    int e = 0;
+    while (x >= 2) {
+        x *= 0.5;
+        e++;
+    }
+    double t = (x - 1) / (x + 1), t2 = t * t, term = t, log_m = 0;
+    for (int k = 1; k < 60; k += 2) {
+        log_m += term / k;
+        term *= t2;
+    }
+    double y = -s * (e + 2 * log_m / DATA_LN2);
+    int whole = (int)y;
+    if (whole > y) {
+        whole--;
+    }
+    double f = (y - whole) * DATA_LN2, power = 1;
+    term = 1;
+    for (int n = 1; n < 30; n++) {
+        term *= f / n;
+        power += term;
+    }
+    for (; whole < 0; whole++) {
+        power *= 0.5;
+    }
+    for (; whole > 0; whole--) {
+        power *= 2;
+    }
+    return power;
+}
+
+// everything a fill thread needs, keys are generated at 64 bits and shifted
+// down to the width
+typedef struct {
+    void *arr;
+    size_t size;
+    int bits;
+    data_spec spec;
+    uint64_t seed;
+    uint64_t step;          // sorted / reverse: key space per key
+    uint64_t *values;       // few_unique / zipf: the distinct keys
+    double *cdf;            // zipf: running sum of the rank weights
+    uint32_t distinct;
+} data_fill;
+
+static inline uint64_t data_key(const data_fill *fill, size_t i) {
+    uint64_t random = data_random(fill->seed, i);
+    uint64_t top = fill->bits == 64 ? UINT64_MAX : UINT32_MAX;
+
+    switch (fill->spec.dist) {
+    case DATA_UNIFORM:
+        if (fill->spec.range) {
+            return (uint64_t)(((unsigned __int128)random * fill->spec.range) >> 64);
+        }
+        return random & top;
+    case DATA_FEW_UNIQUE:
+        return fill->values[random % fill->distinct];
+    case DATA_SORTED:
+    case DATA_REVERSE: {
+        size_t rank = fill->spec.dist == DATA_SORTED ? i : fill->size - 1 - i;
+        return rank * fill->step + (fill->step ? random % fill->step : 0);
+    }
+    case DATA_ZIPF: {
+        // inverse cdf by binary search
+        double u = (double)(random >> 11) / (double)(1ull << 53) * fill->cdf[fill->distinct - 1];
+        uint32_t lo = 0, hi = fill->distinct - 1;
+        while (lo < hi) {
+            uint32_t mid = (lo + hi) / 2;
+            if (fill->cdf[mid] < u) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return fill->values[lo];
+    }
+    default:
+        return 0;
+    }
+}
+
+static inline void data_fill_range(void *context, size_t lo, size_t hi, int part) {
+    const data_fill *fill = (const data_fill *)context;
+    (void)part;
+    if (fill->bits == 64) {
+        uint64_t *arr = (uint64_t *)fill->arr;
+        for (size_t i = lo; i < hi; i++) {
+            arr[i] = data_key(fill, i);
+        }
+    } else {
+        uint32_t *arr = (uint32_t *)fill->arr;
+        for (size_t i = lo; i < hi; i++) {
+            arr[i] = (uint32_t)data_key(fill, i);
+        }
+    }
+}
+
+static inline void data_fill_keys(void *arr, int bits, size_t size, data_spec spec, uint64_t seed, int num_threads) {
+    data_fill fill;
+    memset(&fill, 0, sizeof(fill));
+    fill.arr = arr;
+    fill.size = size;
+    fill.bits = bits;
+    fill.spec = spec;
+    fill.seed = data_random(seed, spec.dist);
+    uint64_t top = bits == 64 ? UINT64_MAX : UINT32_MAX;
+
+    if (spec.dist == DATA_SORTED || spec.dist == DATA_REVERSE) {
+        fill.step = top / (size + 1);
+    }
+    if (spec.dist == DATA_FEW_UNIQUE || spec.dist == DATA_ZIPF) {
+        fill.distinct = spec.distinct ? spec.distinct : (spec.dist == DATA_ZIPF ? DATA_ZIPF_KEYS : DATA_FEW_UNIQUE_KEYS);
+        fill.values = malloc(fill.distinct * sizeof(uint64_t));
+        fill.cdf = spec.dist == DATA_ZIPF ? malloc(fill.distinct * sizeof(double)) : NULL;
+        if (!fill.values || (spec.dist == DATA_ZIPF && !fill.cdf)) {
+            perror("Failed to allocate memory");
+            exit(EXIT_FAILURE);
+        }
+        // the distinct keys come from a stream of their own, past every key index
+        double exponent = spec.exponent > 0 ? spec.exponent : 1.0;
+        double total = 0;
+        for (uint32_t v = 0; v < fill.distinct; v++) {
+            fill.values[v] = data_random(~fill.seed, v) & top;
+            if (fill.cdf) {
+                total += data_pow_neg(v + 1, exponent);
+                fill.cdf[v] = total;
+            }
+        }
+    }
+
+    data_parallel(size, data_threads(num_threads, size), data_fill_range, &fill);
+    free(fill.cdf);
+    free(fill.values);
+}
+
+static inline void data_fill_u32(uint32_t *arr, size_t size, data_spec spec, uint64_t seed, int num_threads) {
+    data_fill_keys(arr, 32, size, spec, seed, num_threads);
+}
+
+static inline void data_fill_u64(uint64_t *arr, size_t size, data_spec spec, uint64_t seed, int num_threads) {
+    data_fill_keys(arr, 64, size, spec, seed, num_threads);
+}
+
+// result of scanning one range: descents seen and the checksum of its keys
+typedef struct {
+    int sorted;
+    data_checksum checksum;
+} data_scan;
+
+// the sums of both hashes and whether every neighbour pair is in order
+static inline void data_scan_u32_scalar(const uint32_t *arr, size_t size, data_scan *scan) {
+    uint64_t sum0 = 0, sum1 = 0;
+    int descents = 0;
+    for (size_t i = 0; i < size; i++) {
+        sum0 += data_mix32(arr[i] ^ DATA_SALT0);
+        sum1 += data_mix32(arr[i] + DATA_SALT1);
+        descents |= i > 0 && arr[i - 1] > arr[i];
+    }
+    scan->sorted = !descents;
+    scan->checksum.sum[0] = sum0;
+    scan->checksum.sum[1] = sum1;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i data_mix32_avx2(__m256i h) {
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+    h = _mm256_mullo_epi32(h, _mm256_set1_epi32((int)0x85EBCA6Bu));
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 13));
+    h = _mm256_mullo_epi32(h, _mm256_set1_epi32((int)0xC2B2AE35u));
+    return _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+}
+
+// 8 keys per step: max(a[i], a[i + 1]) == a[i + 1] for all 8 pairs, both hashes
+// widened into 4 64 bit sums each
+__attribute__((target("avx2")))
+static inline void data_scan_u32_avx2(const uint32_t *arr, size_t size, data_scan *scan) {
+    __m256i in_order = _mm256_set1_epi32(-1);
+    __m256i sum0 = _mm256_setzero_si256(), sum1 = _mm256_setzero_si256();
+    __m256i salt0 = _mm256_set1_epi32((int)DATA_SALT0), salt1 = _mm256_set1_epi32((int)DATA_SALT1);
+
+    size_t i = 0;
+    for (; i + 9 <= size; i += 8) {
+        __m256i keys = _mm256_loadu_si256((const __m256i *)&arr[i]);
+        __m256i next = _mm256_loadu_si256((const __m256i *)&arr[i + 1]);
+        in_order = _mm256_and_si256(in_order, _mm256_cmpeq_epi32(_mm256_max_epu32(keys, next), next));
+
+        __m256i h0 = data_mix32_avx2(_mm256_xor_si256(keys, salt0));
+        __m256i h1 = data_mix32_avx2(_mm256_add_epi32(keys, salt1));
+        sum0 = _mm256_add_epi64(sum0, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(h0)));
+        sum0 = _mm256_add_epi64(sum0, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(h0, 1)));
+        sum1 = _mm256_add_epi64(sum1, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(h1)));
+        sum1 = _mm256_add_epi64(sum1, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(h1, 1)));
+    }
+
+    // the rest, the pair before arr[i] was compared by the last step
+    data_scan tail;
+    data_scan_u32_scalar(arr + i, size - i, &tail);
+
+    uint64_t lanes0[4], lanes1[4];
+    _mm256_storeu_si256((__m256i *)lanes0, sum0);
+    _mm256_storeu_si256((__m256i *)lanes1, sum1);
+    scan->sorted = _mm256_movemask_epi8(in_order) == -1 && tail.sorted;
+    scan->checksum.sum[0] = tail.checksum.sum[0] + lanes0[0] + lanes0[1] + lanes0[2] + lanes0[3];
+    scan->checksum.sum[1] = tail.checksum.sum[1] + lanes1[0] + lanes1[1] + lanes1[2] + lanes1[3];
+}
+
+static inline void data_scan_u64_range(const uint64_t *arr, size_t size, data_scan *scan) {
+    uint64_t sum0 = 0, sum1 = 0;
+    int descents = 0;
+    for (size_t i = 0; i < size; i++) {
+        uint32_t high = (uint32_t)(arr[i] >> 32), low = (uint32_t)arr[i];
+        sum0 += data_mix32(low ^ data_mix32(high ^ DATA_SALT0));
+        sum1 += data_mix32(low + data_mix32(high + DATA_SALT1));
+        descents |= i > 0 && arr[i - 1] > arr[i];
+    }
+    scan->sorted = !descents;
+    scan->checksum.sum[0] = sum0;
+    scan->checksum.sum[1] = sum1;
+}
+
+typedef struct {
+    const void *arr;
+    int bits;
+    int avx2;
+    data_scan scans[DATA_MAX_THREADS];
+} data_scan_job;
+
+static inline void data_scan_range(void *context, size_t lo, size_t hi, int part) {
+    data_scan_job *job = (data_scan_job *)context;
+    data_scan *scan = &job->scans[part];
+    if (job->bits == 64) {
+        const uint64_t *arr = (const uint64_t *)job->arr;
+        data_scan_u64_range(arr + lo, hi - lo, scan);
+        scan->sorted &= lo == 0 || arr[lo - 1] <= arr[lo];
+    } else {
+        const uint32_t *arr = (const uint32_t *)job->arr;
+        if (job->avx2) {
+            data_scan_u32_avx2(arr + lo, hi - lo, scan);
+        } else {
+            data_scan_u32_scalar(arr + lo, hi - lo, scan);
+        }
+        scan->sorted &= lo == 0 || arr[lo - 1] <= arr[lo];
+    }
+}
+
+// one read of the keys split across the threads, the ranges combined
+static inline data_scan data_scan_keys(const void *arr, int bits, size_t size, int num_threads) {
+    data_scan_job job;
+    __builtin_cpu_init();
+    job.arr = arr;
+    job.bits = bits;
+    job.avx2 = __builtin_cpu_supports("avx2");
+    int parts = data_threads(num_threads, size);
+    data_parallel(size, parts, data_scan_range, &job);
+
+    data_scan result = { 1, { { 0, 0 } } };
+    for (int p = 0; p < parts; p++) {
+        result.sorted &= job.scans[p].sorted;
+        result.checksum.sum[0] += job.scans[p].checksum.sum[0];
+        result.checksum.sum[1] += job.scans[p].checksum.sum[1];
+    }
+    return result;
+}
+
+static inline data_checksum data_checksum_u32(const uint32_t *arr, size_t size, int num_threads) {
+    return data_scan_keys(arr, 32, size, num_threads).checksum;
+}
+
+static inline data_checksum data_checksum_u64(const uint64_t *arr, size_t size, int num_threads) {
+    return data_scan_keys(arr, 64, size, num_threads).checksum;
+}
+
+// checksum of two sets of keys from the checksums of each (keys streamed in blocks)
+static inline data_checksum data_checksum_add(data_checksum a, data_checksum b) {
+    a.sum[0] += b.sum[0];
+    a.sum[1] += b.sum[1];
+    return a;
+}
+
+static inline int data_checksum_equal(data_checksum a, data_checksum b) {
+    return a.sum[0] == b.sum[0] && a.sum[1] == b.sum[1];
+}
+
+static inline int data_verify_u32(const uint32_t *arr, size_t size, data_checksum input, int num_threads) {
+    data_scan scan = data_scan_keys(arr, 32, size, num_threads);
+    return scan.sorted && data_checksum_equal(scan.checksum, input);
+}
+
+static inline int data_verify_u64(const uint64_t *arr, size_t size, data_checksum input, int num_threads) {
+    data_scan scan = data_scan_keys(arr, 64, size, num_threads);
+    return scan.sorted && data_checksum_equal(scan.checksum, input);
+}
+
+#endif
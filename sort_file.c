@@ -0,0 +1,155 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "sort_timing.h"
+#include "mapped_file.h"
+#include "libsort.h"
+
+/* Sort a binary key file through mmap with any engine of libsort
+ * the file (or a copy made by the kernel into the output file) is mapped
+ * shared with MAP_POPULATE / MADV_SEQUENTIAL (see mapped_file.h) and sorted in
+ * place in the mapping, so no key goes through a read / write buffer: the cost
+ * is the sort plus the page faults (taken before the sort by MAP_POPULATE) and
+ * the write back of the dirty pages by the kernel
+ * 32 bit files go to the engine named with -e (sort_array's choice without),
+ * 64 bit files (-w 64) to radix_sort_u64
+ * COMPILE: ./build_libsort.sh && gcc -O3 -pthread sort_file.c -L. -lsort -o sort_file
+ *          gcc -O3 -pthread -DLIBSORT -c sort_file.c (engine only, see libsort.h)
+ * RUN: ./sort_file [-e engine] [-w 32|64] [-t threads] [-H] <input> [output]
+ * without output the input file itself is sorted, -H asks for huge pages
+ */
+
+// sort the keys of the mapping, 0 or -1 with errno set
+static int sort_mapping(mapped_file *m, int key_bits, libsort_engine engine, int num_threads) {
+    size_t key_bytes = key_bits == 64 ? sizeof(uint64_t) : sizeof(uint32_t);
+    if (m->bytes % key_bytes != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    size_t size = m->bytes / key_bytes;
+    if (key_bits == 64) {
+        radix_sort_u64(m->data, size);
+    } else if (engine == LIBSORT_NUM_ENGINES) {
+        libsort_sort(m->data, size, num_threads);
+    } else {
+        libsort_sort_with(engine, m->data, size, num_threads);
+    }
+    return 0;
+}
+
+// sorts the key_bits (32 or 64) bit keys of input, into output when it isn't
+// NULL and in place otherwise, engine LIBSORT_NUM_ENGINES leaves the choice to
+// sort_array, flags are the MAP_FILE_* flags, returns 0 or -1 with errno set
+int libsort_sort_file(const char *input, const char *output, int key_bits,
+                      libsort_engine engine, int num_threads, int flags) {
+    mapped_file m;
+    int mapped = output ? map_output(input, output, flags, &m) : map_file(input, flags, &m);
+    if (mapped != 0) {
+        return -1;
+    }
+
+    int failed = sort_mapping(&m, key_bits, engine, num_threads);
+    int saved = errno;
+    failed |= unmap_file(&m);
+    if (failed && saved) {
+        errno = saved;
+    }
+    return failed ? -1 : 0;
+}
+
+#ifndef LIBSORT
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-e engine] [-w 32|64] [-t threads] [-H] <input> [output]\n", name);
+    fprintf(stderr, "engines:");
+    for (int e = 0; e < LIBSORT_NUM_ENGINES; e++) {
+        fprintf(stderr, " %s", libsort_engine_name((libsort_engine)e));
+    }
+    fprintf(stderr, "\n");
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+    libsort_engine engine = LIBSORT_NUM_ENGINES;
+    int key_bits = 32;
+    int num_threads = 0;
+    int flags = 0;
+    int option;
+
+    while ((option = getopt(argc, argv, "e:w:t:H")) != -1) {
+        switch (option) {
+        case 'e':
+            for (engine = 0; engine < LIBSORT_NUM_ENGINES; engine++) {
+                if (strcmp(optarg, libsort_engine_name(engine)) == 0) {
+                    break;
+                }
+            }
+            if (engine == LIBSORT_NUM_ENGINES) {
+                usage(argv[0]);
+            }
+            break;
+        case 'w':
+            key_bits = atoi(optarg);
+            if (key_bits != 32 && key_bits != 64) {
+                usage(argv[0]);
+            }
+            break;
+        case 't':
+            num_threads = atoi(optarg);
+            break;
+        case 'H':
+            flags |= MAP_FILE_HUGE;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (optind >= argc) {
+        usage(argv[0]);
+    }
+    const char *input = argv[optind];
+    const char *output = (optind + 1 < argc) ? argv[optind + 1] : NULL;
+
+    // mapping (and the copy into the output) and the sort are timed apart
+    uint64_t start, mapped_at, end;
+    mapped_file m;
+    start = rdtsc_start();
+    if ((output ? map_output(input, output, flags, &m) : map_file(input, flags, &m)) != 0) {
+        perror("Failed to map key file");
+        return 1;
+    }
+    mapped_at = rdtsc_stop();
+    if (sort_mapping(&m, key_bits, engine, num_threads) != 0) {
+        perror("Failed to sort key file");
+        return 1;
+    }
+    end = rdtsc_stop();
+
+    // the sorted mapping is checked before it is released
+    size_t size = m.bytes / (key_bits / 8);
+    for (size_t i = 1; i < size; i++) {
+        int descent = key_bits == 64 ? ((uint64_t *)m.data)[i - 1] > ((uint64_t *)m.data)[i]
+                                     : ((uint32_t *)m.data)[i - 1] > ((uint32_t *)m.data)[i];
+        if (descent) {
+            printf("File sorting failed.\n");
+            return 1;
+        }
+    }
+
+    const char *name = key_bits == 64 ? "radix_u64" :
+                       engine == LIBSORT_NUM_ENGINES ? "sort_array" : libsort_engine_name(engine);
+    printf("%s: %zu keys, map " TIMING_FMT ", sort " TIMING_FMT "%s\n", name, size,
+           TIMING_ARGS(mapped_at - start, size), TIMING_ARGS(end - mapped_at, size),
+           m.huge ? " (huge pages)" : "");
+    if (unmap_file(&m) != 0) {
+        perror("Failed to write key file");
+        return 1;
+    }
+    printf("done and validated\n");
+    return 0;
+}
+#endif
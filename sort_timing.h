@@ -0,0 +1,92 @@
+#ifndef SORT_TIMING_H
+#define SORT_TIMING_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include <cpuid.h>
+#include <x86intrin.h>
+
+/* Timing of the benchmark mains
+ * rdtsc alone isn't ordered with the code around it, the CPU may read the
+ * counter before the earlier loads finished or after the sort already
+ * started, so the reads are fenced:
+ *   rdtsc_start   lfence, rdtsc, lfence (nothing of the sort starts before)
+ *   rdtsc_stop    rdtscp (waits for everything before it), lfence
+ * cycles are TSC ticks, which only mean time at the TSC's frequency, so the
+ * first conversion calibrates it against CLOCK_MONOTONIC_RAW (TIMING_CALIBRATE_NS
+ * of busy waiting, about 20 ms) and every main reports ns and keys per second
+ * next to the cycles, comparable across machine types and clock speeds
+ * without an invariant TSC (CPUID 0x80000007, EDX bit 8) the ticks follow the
+ * core clock and the conversion is only an estimate, a warning says so
+ * printf("sort time: " TIMING_FMT "\n", TIMING_ARGS(cycles, keys)) prints
+ * "sort time: <cycles> cycles, <ms> ms, <M> Mkeys/s"
+ */
+
+#define TIMING_CALIBRATE_NS 20000000ull
+
+#define TIMING_FMT "%lu cycles, %.3f ms, %.2f Mkeys/s"
+#define TIMING_ARGS(cycles, keys) \
+    (unsigned long)(cycles), timing_ns(cycles) / 1e6, timing_keys_per_s(cycles, keys) / 1e6
+
+static inline uint64_t rdtsc_start(void) {
+    _mm_lfence();
+    uint64_t tsc = __rdtsc();
+    _mm_lfence();
+    return tsc;
+}
+
+static inline uint64_t rdtsc_stop(void) {
+    unsigned int aux;
+    uint64_t tsc = __rdtscp(&aux);
+    _mm_lfence();
+    return tsc;
+}
+
+static inline uint64_t monotonic_raw_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &t);
+    return (uint64_t)t.tv_sec * 1000000000ull + (uint64_t)t.tv_nsec;
+}
+
+static inline int tsc_invariant(void) {
+    unsigned int a, b, c, d;
+    if (!__get_cpuid(0x80000007, &a, &b, &c, &d)) {
+        return 0;
+    }
+    return (d >> 8) & 1;
+}
+
+// TSC ticks per ns, measured once per program
+static inline double tsc_per_ns(void) {
+    static double ticks_per_ns = 0;
+    if (ticks_per_ns == 0) {
+        if (!tsc_invariant()) {
+            fprintf(stderr, "warning: no invariant TSC, times in ns are estimates\n");
+        }
+        // the clock reads bracket the counter reads, their midpoints are compared
+        uint64_t ns_before = monotonic_raw_ns();
+        uint64_t tsc_begin = rdtsc_start();
+        uint64_t ns_begin = (ns_before + monotonic_raw_ns()) / 2;
+        uint64_t ns_end, tsc_end;
+        do {
+            ns_before = monotonic_raw_ns();
+            tsc_end = rdtsc_stop();
+            ns_end = (ns_before + monotonic_raw_ns()) / 2;
+        } while (ns_end - ns_begin < TIMING_CALIBRATE_NS);
+        ticks_per_ns = (double)(tsc_end - tsc_begin) / (double)(ns_end - ns_begin);
+    }
+    return ticks_per_ns;
+}
+
+static inline double timing_ns(uint64_t cycles) {
+    return cycles / tsc_per_ns();
+}
+
+static inline double timing_keys_per_s(uint64_t cycles, size_t keys) {
+    double ns = timing_ns(cycles);
+    return ns > 0 ? keys / ns * 1e9 : 0;
+}
+
+#endif
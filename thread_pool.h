@@ -0,0 +1,253 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+
+/* Work-stealing thread pool
+ * every worker owns a deque: it pushes and pops its own tasks at the bottom
+ * (LIFO, the data is still warm in its cache) while idle workers steal from the
+ * top of other deques (FIFO, the oldest and usually largest piece of work)
+ * threads outside the pool share deque 0
+ * tasks are counted in a task_group, pool_wait keeps running tasks until the
+ * group is empty, so a waiting thread helps instead of blocking and tasks can
+ * spawn and wait on their own subtasks
+ */
+
+typedef void (*task_fn)(void *arg);
+
+// counts the unfinished tasks of one fork / join
+typedef struct {
+    atomic_size_t pending;
+} task_group;
+
+typedef struct {
+    task_fn fn;
+    void *arg;
+    task_group *group;
+} pool_task;
+
+// mutex protected ring buffer, head is the steal end and tail the owner end
+typedef struct {
+    pthread_mutex_t lock;
+    pool_task *tasks;
+    size_t head, tail, capacity;
+} task_deque;
+
+typedef struct thread_pool {
+    int num_workers;
+    pthread_t *threads;
+    task_deque *deques;        // num_workers + 1, deques[0] is for outside threads
+    atomic_size_t queued;      // tasks sitting in any deque
+    atomic_int stop;
+    pthread_mutex_t idle_lock; // idle workers sleep on idle_cond until work is queued
+    pthread_cond_t idle_cond;
+} thread_pool;
+
+// deque slot of the calling thread (0 when it isn't a worker of the pool)
+#ifdef LIBSORT
+// defined once in libsort.c, so every engine of the library sees the same worker slot
+extern __thread thread_pool *pool_current;
+extern __thread int pool_slot;
+#else
+static __thread thread_pool *pool_current = NULL;
+static __thread int pool_slot = 0;
+#endif
+
+static inline void task_group_init(task_group *group) {
+    atomic_init(&group->pending, 0);
+}
+
+static inline void deque_push(task_deque *deque, pool_task task) {
+    pthread_mutex_lock(&deque->lock);
+    if (deque->tail - deque->head == deque->capacity) {
+        // grow the ring, keeping the tasks in order
+        size_t capacity = deque->capacity * 2;
+        pool_task *tasks = malloc(capacity * sizeof(pool_task));
+        if (!tasks) {
+            perror("Failed to allocate memory");
+            exit(EXIT_FAILURE);
+        }
+        for (size_t i = deque->head; i < deque->tail; i++) {
+            tasks[i % capacity] = deque->tasks[i % deque->capacity];
+        }
+        free(deque->tasks);
+        deque->tasks = tasks;
+        deque->capacity = capacity;
+    }
+    deque->tasks[deque->tail % deque->capacity] = task;
+    deque->tail++;
+    pthread_mutex_unlock(&deque->lock);
+}
+
+// owner end
+static inline int deque_pop(task_deque *deque, pool_task *task) {
+    int found = 0;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->tail > deque->head) {
+        deque->tail--;
+        *task = deque->tasks[deque->tail % deque->capacity];
+        found = 1;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+// thief end
+static inline int deque_steal(task_deque *deque, pool_task *task) {
+    int found = 0;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->tail > deque->head) {
+        *task = deque->tasks[deque->head % deque->capacity];
+        deque->head++;
+        found = 1;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+static inline int pool_own_slot(thread_pool *pool) {
+    return (pool_current == pool) ? pool_slot : 0;
+}
+
+// queue a task on the calling thread's deque and count it in group
+static inline void pool_submit(thread_pool *pool, task_group *group, task_fn fn, void *arg) {
+    pool_task task = { fn, arg, group };
+    atomic_fetch_add(&group->pending, 1);
+    deque_push(&pool->deques[pool_own_slot(pool)], task);
+    atomic_fetch_add(&pool->queued, 1);
+
+    // wake one sleeping worker
+    pthread_mutex_lock(&pool->idle_lock);
+    pthread_cond_signal(&pool->idle_cond);
+    pthread_mutex_unlock(&pool->idle_lock);
+}
+
+// run one task from the own deque or stolen from another one, 0 if there was none
+static inline int pool_run_one(thread_pool *pool) {
+    int slots = pool->num_workers + 1;
+    int self = pool_own_slot(pool);
+    pool_task task;
+
+    int found = deque_pop(&pool->deques[self], &task);
+    for (int i = 1; !found && i < slots; i++) {
+        found = deque_steal(&pool->deques[(self + i) % slots], &task);
+    }
+    if (!found) {
+        return 0;
+    }
+
+    atomic_fetch_sub(&pool->queued, 1);
+    task.fn(task.arg);
+    atomic_fetch_sub(&task.group->pending, 1);
+    return 1;
+}
+
+// help running tasks until every task of group has finished
+static inline void pool_wait(thread_pool *pool, task_group *group) {
+    while (atomic_load(&group->pending) > 0) {
+        if (!pool_run_one(pool)) {
+            // the remaining tasks are running on other threads
+            sched_yield();
+        }
+    }
+}
+
+static void *pool_worker(void *arg) {
+    thread_pool *pool = ((void **)arg)[0];
+    int slot = (int)(intptr_t)((void **)arg)[1];
+    free(arg);
+
+    pool_current = pool;
+    pool_slot = slot;
+
+    while (!atomic_load(&pool->stop)) {
+        if (pool_run_one(pool)) {
+            continue;
+        }
+        pthread_mutex_lock(&pool->idle_lock);
+        while (atomic_load(&pool->queued) == 0 && !atomic_load(&pool->stop)) {
+            pthread_cond_wait(&pool->idle_cond, &pool->idle_lock);
+        }
+        pthread_mutex_unlock(&pool->idle_lock);
+    }
+    return NULL;
+}
+
+// start a pool with num_workers threads (the thread calling pool_wait helps as well)
+static inline thread_pool *pool_create(int num_workers) {
+    if (num_workers < 0) {
+        num_workers = 0;
+    }
+
+    thread_pool *pool = malloc(sizeof(thread_pool));
+    if (!pool) {
+        perror("Failed to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+    pool->num_workers = num_workers;
+    pool->threads = malloc((num_workers + 1) * sizeof(pthread_t));
+    pool->deques = malloc((num_workers + 1) * sizeof(task_deque));
+    if (!pool->threads || !pool->deques) {
+        perror("Failed to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+    atomic_init(&pool->queued, 0);
+    atomic_init(&pool->stop, 0);
+    pthread_mutex_init(&pool->idle_lock, NULL);
+    pthread_cond_init(&pool->idle_cond, NULL);
+
+    for (int i = 0; i <= num_workers; i++) {
+        task_deque *deque = &pool->deques[i];
+        pthread_mutex_init(&deque->lock, NULL);
+        deque->capacity = 64;
+        deque->head = deque->tail = 0;
+        deque->tasks = malloc(deque->capacity * sizeof(pool_task));
+        if (!deque->tasks) {
+            perror("Failed to allocate memory");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    for (int i = 1; i <= num_workers; i++) {
+        void **arg = malloc(2 * sizeof(void *));
+        if (!arg) {
+            perror("Failed to allocate memory");
+            exit(EXIT_FAILURE);
+        }
+        arg[0] = pool;
+        arg[1] = (void *)(intptr_t)i;
+        if (pthread_create(&pool->threads[i], NULL, pool_worker, arg) != 0) {
+            fprintf(stderr, "Failed to create thread %d\n", i);
+            exit(EXIT_FAILURE);
+        }
+    }
+    return pool;
+}
+
+// stop the workers, every group must have been waited on
+static inline void pool_destroy(thread_pool *pool) {
+    atomic_store(&pool->stop, 1);
+    pthread_mutex_lock(&pool->idle_lock);
+    pthread_cond_broadcast(&pool->idle_cond);
+    pthread_mutex_unlock(&pool->idle_lock);
+
+    for (int i = 1; i <= pool->num_workers; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    for (int i = 0; i <= pool->num_workers; i++) {
+        pthread_mutex_destroy(&pool->deques[i].lock);
+        free(pool->deques[i].tasks);
+    }
+    pthread_mutex_destroy(&pool->idle_lock);
+    pthread_cond_destroy(&pool->idle_cond);
+    free(pool->deques);
+    free(pool->threads);
+    free(pool);
+}
+
+#endif